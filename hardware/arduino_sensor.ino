@@ -14,7 +14,11 @@
  *   HC-SR04 ECHO → Arduino Pin 10
  * 
  * Output: JSON over serial at 9600 baud
- *   {"water_level_cm": 45.2, "distance_raw": 45.2, "valid": true}
+ *   {"water_level_cm": 45.2, "distance_raw": 45.0, "echo_std": 0.4, "valid": true}
+ *
+ *   water_level_cm is the rolling average, distance_raw the latest single
+ *   echo (-1 if it failed) and echo_std the spread of the averaged echoes.
+ *   The host uses the last two to weight each reading in its Kalman filter.
  */
 
 // Pin definitions
@@ -41,6 +45,9 @@ int readIndex = 0;
 float total = 0;
 bool bufferFilled = false;
 
+// Latest single measurement (-1 if the last echo failed)
+float lastRawDistance = -1;
+
 void setup() {
     // Initialize serial communication
     Serial.begin(SERIAL_BAUD);
@@ -104,6 +111,7 @@ float measureDistance() {
  */
 float getAveragedDistance() {
     float distance = measureDistance();
+    lastRawDistance = distance;
     
     if (distance < 0) {
         // Invalid reading - don't update average
@@ -133,6 +141,27 @@ float getAveragedDistance() {
     }
 }
 
+/**
+ * Standard deviation of the echoes in the rolling average buffer
+ */
+float getEchoSpread() {
+    int count = bufferFilled ? NUM_SAMPLES : readIndex;
+    if (count < 2) return -1;
+    
+    float mean = 0;
+    for (int i = 0; i < count; i++) {
+        mean += readings[i];
+    }
+    mean /= count;
+    
+    float sumSq = 0;
+    for (int i = 0; i < count; i++) {
+        float d = readings[i] - mean;
+        sumSq += d * d;
+    }
+    return sqrt(sumSq / (count - 1));
+}
+
 /**
  * Convert distance to water level percentage
  * 0% = empty (water far from sensor)
@@ -161,7 +190,9 @@ void sendData(float distance, float waterLevelPercent, bool valid) {
     Serial.print(", \"water_level_percent\": ");
     Serial.print(waterLevelPercent, 1);
     Serial.print(", \"distance_raw\": ");
-    Serial.print(distance, 1);
+    Serial.print(lastRawDistance, 1);
+    Serial.print(", \"echo_std\": ");
+    Serial.print(getEchoSpread(), 2);
     Serial.print(", \"valid\": ");
     Serial.print(valid ? "true" : "false");
     Serial.print(", \"timestamp\": ");
@@ -4,14 +4,26 @@ DrainSentinel: AI Blockage Detection Module
 
 Handles loading and running the Edge Impulse model for drain blockage detection.
 Supports both the Metis AI accelerator and CPU-only inference.
+
+A TensorFlow Lite export of the model (models/drain_blockage.tflite) is
+preferred when present: it runs in-process (see tflite_runner.py) instead
+of through the .eim runner's JSON socket.
 """
 
 import cv2
 import logging
 import numpy as np
 import os
+import threading
+import time
 from pathlib import Path
 
+from frame import Frame
+from jpeg_decode import decode_jpeg, jpeg_size, read_image
+from preprocess import Preprocessor
+from result_cache import OFFLINE_CACHE_FILE, shared_cache
+from tflite_runner import TFLITE_AVAILABLE, TFLiteRunner
+
 logger = logging.getLogger('DrainSentinel.AI')
 
 # Try to import Edge Impulse SDK
@@ -29,23 +41,52 @@ class BlockageDetector:
     # Class labels
     LABELS = ['clear', 'partial_blockage', 'full_blockage']
     
-    def __init__(self, model_path=None):
+    def __init__(self, model_path=None, cache=None):
         """
         Initialize the blockage detector.
         
         Args:
-            model_path: Path to the .eim model file. If None, uses default location.
+            model_path: Path to the .eim or .tflite model file. If None, uses
+                models/drain_blockage.tflite if it exists, else the .eim.
+            cache: ResultCache for results by input content; None uses the
+                process-wide shared_cache(), False disables caching
         """
         if model_path is None:
-            model_path = Path('models/drain_blockage.eim')
+            model_path = Path('models/drain_blockage.tflite')
+            if not (TFLITE_AVAILABLE and model_path.exists()):
+                model_path = Path('models/drain_blockage.eim')
         
         self.model_path = Path(model_path)
         self.runner = None
+        self.tflite = None
         self.input_size = (224, 224)  # Default, will be updated from model
         
-        self._init_model()
+        if self.model_path.suffix in ('.tflite', '.lite'):
+            self._init_tflite()
+        else:
+            self._init_model()
+        
+        # The .eim runner takes RGB uint8; TFLite takes whatever the model was quantized to
+        self.preprocess_dtype = self.tflite.preprocess_dtype if self.tflite else np.uint8
+        # Preprocessors reuse scratch buffers and every camera's preprocess
+        # thread calls prepare(), so each thread gets its own
+        self.local = threading.local()
+        
+        # Results are cached per model: a retrained model never sees old results
+        self.cache = shared_cache() if cache is None else cache
+        self.model_id = self._model_id()
         logger.info("BlockageDetector initialized")
     
+    def _model_id(self):
+        """Identifies the loaded model (file name, size, mtime) in cache keys."""
+        if self.tflite is None and self.runner is None:
+            return 'mock'
+        try:
+            stat = self.model_path.stat()
+            return f"{self.model_path.name}:{stat.st_size}:{int(stat.st_mtime)}"
+        except OSError:
+            return str(self.model_path)
+    
     def _init_model(self):
         """Initialize the Edge Impulse model."""
         if not EDGE_IMPULSE_AVAILABLE:
@@ -70,63 +111,280 @@ class BlockageDetector:
             logger.info(f"Model loaded: {model_info['project']['name']}")
             logger.info(f"Input size: {self.input_size}")
             logger.info(f"Labels: {model_info['model_parameters']['labels']}")
-            
+        
         except Exception as e:
             logger.error(f"Failed to load model: {e}")
             self.runner = None
     
+    def _init_tflite(self):
+        """Load the TFLite model into this process."""
+        try:
+            self.tflite = TFLiteRunner(self.model_path, self.LABELS)
+            self.input_size = self.tflite.input_size
+            logger.info(f"Model loaded in-process: {self.model_path.name}")
+            logger.info(f"Input size: {self.input_size}")
+        except Exception as e:
+            logger.error(f"Failed to load TFLite model: {e}")
+            self.tflite = None
+    
+    @property
+    def preprocessor(self):
+        """This thread's Preprocessor for the model input size and type."""
+        if not hasattr(self.local, 'preprocessor'):
+            self.local.preprocessor = Preprocessor(self.input_size, self.preprocess_dtype)
+        return self.local.preprocessor
+    
     def preprocess_image(self, image_path):
         """
         Load and preprocess an image for inference.
         
         Args:
             image_path: Path to the image file
-            
+        
         Returns:
             Preprocessed numpy array, or None if failed
         """
         try:
-            # Load image
-            img = cv2.imread(str(image_path))
+            # Load image (JPEGs are decoded at reduced DCT scale near the input size)
+            img = read_image(image_path, self.input_size)
             
             if img is None:
                 logger.error(f"Failed to load image: {image_path}")
                 return None
             
-            # Resize to model input size
-            img = cv2.resize(img, self.input_size)
-            
-            # Convert BGR to RGB
-            img = cv2.cvtColor(img, cv2.COLOR_BGR2RGB)
-            
-            return img
-            
+            return self.preprocess_array(img)
+        
         except Exception as e:
             logger.error(f"Image preprocessing failed: {e}")
             return None
     
-    def detect(self, image_input):
+    def preprocess_array(self, img, out=None):
+        """
+        Preprocess an in-memory BGR image for inference.
+        
+        Args:
+            img: BGR numpy array (e.g. Frame.image); not modified
+            out: Optional (height, width, 3) buffer to write into
+        
+        Returns:
+            RGB array at the model input size (uint8, or the TFLite
+            model's input type), or None if failed
+        """
+        try:
+            # Area resize and BGR->RGB in one go (see preprocess.py)
+            return self.preprocessor(img, out)
+        
+        except Exception as e:
+            logger.error(f"Image preprocessing failed: {e}")
+            return None
+    
+    def detect(self, image_input, rois=None):
         """
         Run blockage detection on an image.
         
         Args:
-            image_input: Either a file path (str/Path) or a numpy array
-            
+            image_input: A file path (str/Path), a Frame from the camera,
+                or an already preprocessed numpy array
+            rois: Optional list of RegionOfInterest; each region is cropped
+                from the full-resolution frame and all are classified in
+                one batch (not applied to preprocessed arrays)
+        
         Returns:
             Dictionary with:
                 - blocked: Boolean indicating if blockage detected
                 - confidence: Confidence score (0-1)
                 - class_name: Predicted class name
                 - all_scores: Dictionary of all class scores
+                - rois: Per-region results (only with rois)
         """
-        # Handle input type
+        start = time.perf_counter()
+        prepared = self.prepare(image_input, rois)
+        preprocess_ms = (time.perf_counter() - start) * 1000
+        
+        result = self.infer(prepared, rois)
+        if 'timing' in result:
+            result['timing'] = {'preprocess': preprocess_ms, **result['timing']}
+        return result
+    
+    def detect_rois(self, image_input, rois):
+        """
+        Classify each region of interest and report the most severe.
+        
+        Regions are cropped before resizing, so the model sees the drain
+        inlet at a much higher effective resolution than in the full frame.
+        
+        Args:
+            image_input: A file path or a Frame
+            rois: List of RegionOfInterest
+        
+        Returns:
+            The result of the most severe region, plus 'roi' (its name) and
+            'rois' (every region's result)
+        """
+        return self.infer(self.prepare(image_input, rois), rois)
+    
+    def prepare(self, image_input, rois=None):
+        """
+        Decode and preprocess an image for infer().
+        
+        This is the CPU-side half of detect(), split out so it can run on
+        a different thread from inference.
+        
+        Args:
+            image_input: See detect()
+            rois: Optional list of RegionOfInterest
+        
+        Returns:
+            (height, width, 3) tensor, an (N, height, width, 3) batch with
+            one image per region, or None if the image couldn't be loaded
+        """
+        if rois and isinstance(image_input, (str, Path, Frame)):
+            return self._prepare_rois(image_input, rois)
         if isinstance(image_input, (str, Path)):
-            img = self.preprocess_image(image_input)
-        else:
-            img = image_input
+            return self.preprocess_image(image_input)
+        if isinstance(image_input, Frame):
+            return self.preprocess_array(image_input.image_for(self.input_size))
+        return image_input
+    
+    def infer(self, prepared, rois=None):
+        """
+        Classify the output of prepare().
         
-        if img is None:
+        Args:
+            prepared: Tensor or ROI batch from prepare()
+            rois: The regions passed to prepare()
+        
+        Returns:
+            Result dictionary (see detect)
+        """
+        if prepared is None:
             return self._default_result()
+        if prepared.ndim == 4:
+            return self._most_severe(rois, self.detect_batch(prepared))
+        return self._classify(prepared)
+    
+    def infer_batch(self, items):
+        """
+        Classify several prepare() outputs (e.g. from different cameras) in one model call.
+        
+        Args:
+            items: List of (prepared, rois) pairs
+        
+        Returns:
+            List of result dictionaries, one per item
+        """
+        tensors, spans = [], []
+        offset = 0
+        for prepared, rois in items:
+            if prepared is None:
+                spans.append(None)
+                continue
+            images = prepared if prepared.ndim == 4 else prepared[None]
+            spans.append((offset, len(images)))
+            tensors.append(images)
+            offset += len(images)
+        
+        results = self.detect_batch(np.concatenate(tensors)) if tensors else []
+        
+        out = []
+        for (prepared, rois), span in zip(items, spans):
+            if span is None:
+                out.append(self._default_result())
+            elif prepared.ndim == 4:
+                out.append(self._most_severe(rois, results[span[0]:span[0] + span[1]]))
+            else:
+                out.append(results[span[0]])
+        return out
+    
+    def _prepare_rois(self, image_input, rois):
+        """Crop and preprocess each region into one batch."""
+        # Smallest decode that still gives every region its full input size
+        needed = (
+            max(int(np.ceil(self.input_size[0] / max(np.ptp(r.points[:, 0]), 1e-3))) for r in rois),
+            max(int(np.ceil(self.input_size[1] / max(np.ptp(r.points[:, 1]), 1e-3))) for r in rois),
+        )
+        if isinstance(image_input, Frame):
+            image = image_input.image_for(needed)
+        else:
+            image = read_image(image_input, needed)
+            if image is None:
+                logger.error(f"Failed to load image: {image_input}")
+                return None
+        
+        try:
+            batch = self.preprocessor.allocate(len(rois))
+            for roi, out in zip(rois, batch):
+                self.preprocessor(roi.crop(image), out)
+        except Exception as e:
+            logger.error(f"ROI preprocessing failed: {e}")
+            return None
+        return batch
+    
+    def _most_severe(self, rois, results):
+        """Combine per-region results: the most severe class wins, confidence breaks ties."""
+        per_roi = {roi.name: result for roi, result in zip(rois, results)}
+        severity = {name: i for i, name in enumerate(self.LABELS)}
+        name, worst = max(per_roi.items(),
+                          key=lambda item: (severity.get(item[1].get('class_name'), -1),
+                                            item[1].get('confidence', 0)))
+        return {**worst, 'roi': name, 'rois': per_roi}
+    
+    def detect_batch(self, batch):
+        """
+        Classify a batch of preprocessed images in one call.
+        
+        Args:
+            batch: (N, height, width, 3) array from the preprocessor
+        
+        Returns:
+            List of N result dictionaries (see detect)
+        """
+        if not self.cache:
+            return self._run_batch(batch)
+        
+        keys = [self.cache.key(img, self.model_id) for img in batch]
+        results = [self.cache.get(key) for key in keys]
+        misses = [i for i, result in enumerate(results) if result is None]
+        if misses:
+            for i, result in zip(misses, self._run_batch(batch[misses])):
+                self.cache.put(keys[i], result)
+                results[i] = result
+        return results
+    
+    def _run_batch(self, batch):
+        """Run the model on a batch (one call where the backend supports it)."""
+        if self.tflite is not None and len(batch) > 1:
+            try:
+                scores, timing = self.tflite.classify(batch)
+                return [self._scores_result(s, timing) for s in scores]
+            except Exception as e:
+                # Models exported with a fixed batch of 1 can't be resized
+                logger.debug(f"Batched inference unavailable ({e}), classifying one at a time")
+        
+        # The Edge Impulse runner takes one image per request
+        return [self._run_model(img) for img in batch]
+    
+    def _classify(self, img):
+        """Classify one preprocessed image, from the cache if it was seen before."""
+        if not self.cache:
+            return self._run_model(img)
+        
+        key = self.cache.key(img, self.model_id)
+        result = self.cache.get(key)
+        if result is None:
+            result = self._run_model(img)
+            self.cache.put(key, result)
+        return result
+    
+    def _run_model(self, img):
+        """Run the model (or the mock) on one preprocessed image."""
+        if self.tflite is not None:
+            try:
+                scores, timing = self.tflite.classify(img)
+                return self._scores_result(scores[0], timing)
+            except Exception as e:
+                logger.error(f"Inference failed: {e}")
+                return self._default_result()
         
         # Use mock detector if Edge Impulse not available
         if self.runner is None:
@@ -154,11 +412,23 @@ class BlockageDetector:
                 'all_scores': classifications,
                 'inference_time_ms': result['timing']['classification'],
             }
-            
+        
         except Exception as e:
             logger.error(f"Inference failed: {e}")
             return self._default_result()
     
+    def _scores_result(self, classifications, timing):
+        """Build a detection result from class scores."""
+        best_class = max(classifications, key=classifications.get)
+        return {
+            'blocked': best_class in ['partial_blockage', 'full_blockage'],
+            'confidence': classifications[best_class],
+            'class_name': best_class,
+            'all_scores': classifications,
+            'inference_time_ms': timing['invoke'],
+            'timing': dict(timing),
+        }
+    
     def _mock_detect(self, img):
         """
         Mock detection when Edge Impulse is not available.
@@ -211,6 +481,7 @@ class BlockageDetector:
     
     def close(self):
         """Release model resources."""
+        self.tflite = None
         if self.runner is not None:
             self.runner.stop()
             logger.info("Model runner stopped")
@@ -226,13 +497,90 @@ class SimpleBlockageDetector:
     
     Uses color analysis and edge detection as a fallback when
     Edge Impulse is not available or for quick testing.
+    
+    The statistics are scene-level averages, so they are computed on a
+    320x180 copy of the frame (JPEGs are decoded straight to it at 1/4 DCT
+    scale). Edge density uses the fraction of pixels whose Sobel gradient
+    exceeds a threshold instead of running Canny at full resolution.
     """
     
+    ANALYSIS_SIZE = (320, 180)
+    EDGE_THRESHOLD = 80  # |dx| + |dy| of the 3x3 Sobel, ~Canny's 50/150 hysteresis
+    
     def __init__(self):
         """Initialize the simple detector."""
         logger.info("SimpleBlockageDetector initialized (OpenCV-based)")
     
-    def detect(self, image_path):
+    def _load(self, image_input):
+        """
+        BGR image at (about) the analysis size from a path, Frame or array.
+        
+        Returns:
+            (image, scale): scale is how much a reduced-scale JPEG decode
+            shrank the image (for analyze()); image is None if unreadable
+        """
+        if isinstance(image_input, (str, Path)):
+            try:
+                data = Path(image_input).read_bytes()
+            except OSError as e:
+                logger.error(f"Failed to read image {image_input}: {e}")
+                return None, 1.0
+            image = decode_jpeg(data, self.ANALYSIS_SIZE)
+            full_width = (jpeg_size(data) or (None,))[0]
+        elif isinstance(image_input, Frame):
+            image, full_width = image_input.image_for(self.ANALYSIS_SIZE), image_input.shape[1]
+        else:
+            return image_input, 1.0
+        if image is None:
+            return None, 1.0
+        return image, (full_width or image.shape[1]) / image.shape[1]
+    
+    def analyze(self, img, scale=1.0):
+        """
+        Scene statistics of a BGR image.
+        
+        Args:
+            img: BGR image (or a crop of one)
+            scale: How much img was already reduced from the camera frame,
+                e.g. 4 for a crop of a 1/4 scale decode
+        
+        Returns:
+            (darkness, color_variance, edge_density) on the same scale as a
+            full-resolution gray mean, hue std / 90 and Canny edge fraction
+        """
+        factor = img.shape[1] / self.ANALYSIS_SIZE[0]
+        if factor > 1:
+            img = cv2.resize(img, self.ANALYSIS_SIZE, interpolation=cv2.INTER_AREA)
+            scale *= factor
+        
+        gray = cv2.cvtColor(img, cv2.COLOR_BGR2GRAY)
+        darkness_score = 1 - cv2.mean(gray)[0] / 255
+        
+        # Hue std without splitting channels (meanStdDev does all three in one pass)
+        _, std = cv2.meanStdDev(cv2.cvtColor(img, cv2.COLOR_BGR2HSV))
+        color_variance = std[0, 0] / 90  # Normalize to 0-1
+        
+        # Sobel marks a ~2 pixel band where Canny keeps a 1 pixel line, and an
+        # edge 1/scale as long covers 1/scale^2 of the pixels; undo both so
+        # the density matches the full-resolution Canny figure
+        dx = cv2.Sobel(gray, cv2.CV_16S, 1, 0)
+        dy = cv2.Sobel(gray, cv2.CV_16S, 0, 1)
+        magnitude = cv2.add(cv2.convertScaleAbs(dx), cv2.convertScaleAbs(dy))
+        edge_density = cv2.countNonZero(cv2.compare(magnitude, self.EDGE_THRESHOLD, cv2.CMP_GT))
+        edge_density /= magnitude.size * 2 * scale
+        
+        return darkness_score, color_variance, edge_density
+    
+    @staticmethod
+    def score(darkness_score, color_variance, edge_density):
+        """Combined blockage score (0-1) from analyze() statistics."""
+        return (
+            0.4 * darkness_score +
+            0.3 * color_variance +
+            0.3 * min(1.0, edge_density * 10)
+        )
+    
+    def detect(self, image_input):
         """
         Detect blockage using simple image analysis.
         
@@ -240,35 +588,20 @@ class SimpleBlockageDetector:
         1. Dark regions (debris)
         2. Unusual colors (trash, leaves)
         3. Texture changes (water vs. debris)
+        
+        Args:
+            image_input: A file path, a Frame, or a BGR numpy array
         """
         try:
-            img = cv2.imread(str(image_path))
+            img, scale = self._load(image_input)
             
             if img is None:
                 return {'blocked': False, 'confidence': 0, 'error': True}
             
-            # Convert to different color spaces
-            gray = cv2.cvtColor(img, cv2.COLOR_BGR2GRAY)
-            hsv = cv2.cvtColor(img, cv2.COLOR_BGR2HSV)
-            
-            # Analyze darkness (blocked drains often darker)
-            mean_brightness = np.mean(gray)
-            darkness_score = 1 - (mean_brightness / 255)
-            
-            # Analyze color variance (debris has varied colors)
-            h, s, v = cv2.split(hsv)
-            color_variance = np.std(h) / 90  # Normalize to 0-1
-            
-            # Analyze edges (debris has more edges than water)
-            edges = cv2.Canny(gray, 50, 150)
-            edge_density = np.sum(edges > 0) / edges.size
+            darkness_score, color_variance, edge_density = self.analyze(img, scale)
             
             # Combine scores
-            blockage_score = (
-                0.4 * darkness_score +
-                0.3 * color_variance +
-                0.3 * min(1.0, edge_density * 10)
-            )
+            blockage_score = self.score(darkness_score, color_variance, edge_density)
             
             # Determine class
             if blockage_score > 0.6:
@@ -291,29 +624,118 @@ class SimpleBlockageDetector:
                 },
                 'simple_detector': True,
             }
-            
+        
         except Exception as e:
             logger.error(f"Simple detection failed: {e}")
             return {'blocked': False, 'confidence': 0, 'error': True}
 
 
+def benchmark_simple_detector(iterations=20):
+    """Compare the downsampled simple detector with full-resolution analysis."""
+    import tempfile
+    
+    print("Benchmarking simple detector (1280x720)...")
+    
+    def full_resolution(img):
+        # The statistics as originally computed on the full frame
+        gray = cv2.cvtColor(img, cv2.COLOR_BGR2GRAY)
+        hsv = cv2.cvtColor(img, cv2.COLOR_BGR2HSV)
+        h, s, v = cv2.split(hsv)
+        edges = cv2.Canny(gray, 50, 150)
+        return 1 - np.mean(gray) / 255, np.std(h) / 90, np.sum(edges > 0) / edges.size
+    
+    np.random.seed(1)
+    y, x = np.mgrid[0:720, 0:1280]
+    base = 128 + 60 * np.sin(x / 37.0) * np.cos(y / 23.0)
+    street = np.clip(np.dstack([base, base * 0.8 + 20, 255 - base]) + np.random.normal(0, 3, (720, 1280, 3)), 0, 255)
+    
+    bag = street.copy()
+    bag[280:560, 440:840] = 40
+    leaves = street.copy()
+    for _ in range(150):
+        colour = tuple(int(c) for c in np.random.randint(0, 255, 3))
+        center = (int(np.random.randint(0, 1280)), int(np.random.randint(0, 720)))
+        axes = (int(np.random.randint(5, 30)), int(np.random.randint(3, 15)))
+        cv2.ellipse(leaves, center, axes, int(np.random.randint(0, 180)), 0, 360, colour, -1)
+    grate = np.full((720, 1280, 3), 100.0)
+    for i in range(0, 1280, 40):
+        grate[:, i:i + 8] = 30
+    grate += np.random.normal(0, 4, grate.shape)
+    water = np.full((720, 1280, 3), (90, 70, 50), dtype=np.float64) + np.random.normal(0, 8, (720, 1280, 3))
+    
+    detector = SimpleBlockageDetector()
+    ok = True
+    for name, scene in (('street', street), ('bag', bag), ('leaves', leaves), ('grate', grate), ('water', water)):
+        img = scene.astype(np.uint8)
+        reference = detector.score(*full_resolution(img))
+        score = detector.score(*detector.analyze(img))
+        print(f"  {name}: full-resolution score {reference:.3f}, downsampled {score:.3f}")
+        ok &= abs(score - reference) < 0.03
+        
+        # However the scene arrives (array, JPEG file, MJPEG frame), detect() sees the same statistics
+        data = cv2.imencode('.jpg', img, [cv2.IMWRITE_JPEG_QUALITY, 95])[1].tobytes()
+        with tempfile.NamedTemporaryFile(suffix='.jpg') as f:
+            f.write(data)
+            f.flush()
+            routes = [detector.detect(source)['all_scores'] for source in (img, f.name, Frame(jpeg=data))]
+        print(f"  {name}: edge density from array / file / frame "
+              + " / ".join(f"{r['edge_density']:.3f}" for r in routes))
+        scores = [detector.score(r['darkness'], r['color_variance'], r['edge_density']) for r in routes]
+        ok &= max(scores) - min(scores) < 0.02
+    
+    def timed(fn, arg):
+        fn(arg)
+        start = time.perf_counter()
+        for _ in range(iterations):
+            fn(arg)
+        return (time.perf_counter() - start) / iterations * 1000
+    
+    img = leaves.astype(np.uint8)
+    data = cv2.imencode('.jpg', img, [cv2.IMWRITE_JPEG_QUALITY, 85])[1].tobytes()
+    full = timed(full_resolution, img)
+    fast = timed(detector.analyze, img)
+    decode_full = timed(lambda d: full_resolution(cv2.imdecode(np.frombuffer(d, np.uint8), cv2.IMREAD_COLOR)), data)
+    decode_fast = timed(lambda d: detector.analyze(*detector._load(Frame(jpeg=d))), data)
+    print(f"  From array: full resolution {full:.2f} ms, downsampled {fast:.2f} ms ({full / fast:.1f}x)")
+    print(f"  From JPEG:  full resolution {decode_full:.2f} ms, scaled decode {decode_fast:.2f} ms "
+          f"({decode_full / decode_fast:.1f}x)")
+    
+    print("Simple detector test PASSED" if ok else "Simple detector test FAILED")
+
+
 def test_detector():
     """Test the blockage detector."""
+    from capture_store import CaptureStore
+    
     print("Testing blockage detector...")
     
     detector = BlockageDetector()
     
-    # Test with a sample image
-    test_images = list(Path('data/captures').glob('*.jpg'))
+    # Images analyzed by earlier runs are answered from the cache
+    detector.cache.load(OFFLINE_CACHE_FILE)
     
-    if not test_images:
+    # The last few captures from the ring (read-only, the gateway may be
+    # writing it), or loose JPEGs when there is no ring
+    samples = []
+    try:
+        store = CaptureStore('data/captures', read_only=True)
+    except FileNotFoundError:
+        samples = [(path.name, path) for path in sorted(Path('data/captures').glob('*.jpg'))[-3:]]
+    else:
+        for record in store.find()[-3:]:
+            data = store.read(record)
+            if data is not None:
+                samples.append((record.id, Frame(None, record.timestamp, record.sequence, jpeg=data)))
+        store.close()
+    
+    if not samples:
         print("No test images found in data/captures/")
         print("Capture some images first with: python3 camera.py")
         return
     
-    for img_path in test_images[:3]:
-        print(f"\nAnalyzing: {img_path.name}")
-        result = detector.detect(img_path)
+    for name, image_input in samples:
+        print(f"\nAnalyzing: {name}")
+        result = detector.detect(image_input)
         
         print(f"  Blocked: {result['blocked']}")
         print(f"  Class: {result['class_name']}")
@@ -321,11 +743,20 @@ def test_detector():
         
         if 'all_scores' in result:
             print(f"  Scores: {result['all_scores']}")
+        if result.get('cached'):
+            print("  (cached result)")
+    
+    detector.cache.save(OFFLINE_CACHE_FILE)
+    print(f"\nResult cache: {detector.cache.get_stats()}")
     
     detector.close()
     print("\nTest complete")
 
 
 if __name__ == '__main__':
+    import sys
     logging.basicConfig(level=logging.DEBUG)
-    test_detector()
+    if sys.argv[1:] == ['simple']:
+        benchmark_simple_detector()
+    else:
+        test_detector()
@@ -142,9 +142,18 @@ class AlertSystem:
             f"Blockage: {'Yes' if state.get('blockage_detected') else 'No'} "
             f"({state.get('blockage_confidence', 0)*100:.0f}% confidence)\n"
             f"Rate of Rise: {state.get('rate_of_rise', 0):.1f} cm/min\n"
-            f"Time: {datetime.now().strftime('%Y-%m-%d %H:%M:%S')}"
         )
         
+        minutes = state.get('minutes_to_critical')
+        if minutes is not None:
+            details += f"Time to Critical: ~{minutes:.0f} min\n"
+        
+        health = state.get('sensor_health', 'OK')
+        if health != 'OK':
+            details += f"Level Sensor: {health} (readings may be unreliable)\n"
+        
+        details += f"Time: {datetime.now().strftime('%Y-%m-%d %H:%M:%S')}"
+        
         return f"[DrainSentinel {level}] {base_message}{details}"
     
     def _send_console(self, level, message):
@@ -291,6 +291,7 @@ class MockArduinoSerial:
                 'water_level_cm': 100 - level,  # Invert for distance
                 'water_level_percent': level,
                 'distance_raw': 100 - level,
+                'echo_std': 0.58,  # Std of the uniform noise above
                 'valid': True,
                 'timestamp': int(time.time() * 1000),
             }
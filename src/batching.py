@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Shared Batched Inference
+
+Junctions with several inlets run one camera per inlet. Instead of a
+model per camera, every camera's pipeline hands its preprocessed frame to
+one BatchInferenceWorker, which owns the model. The worker collects
+requests until it has max_batch of them or the oldest has waited
+deadline_ms, then classifies them all in one call and wakes each caller
+with its own result.
+
+With a single camera max_batch is 1 and requests run immediately. With N
+cameras, frames captured at about the same time share one model
+invocation, which for batched backends (TFLite) costs much less than N
+separate ones. No request waits more than the deadline for company.
+"""
+
+import logging
+import queue
+import threading
+import time
+
+logger = logging.getLogger('DrainSentinel.Batching')
+
+
+class InferenceRequest:
+    """One caller's prepared input, waiting for its result."""
+    
+    __slots__ = ('prepared', 'rois', 'submitted', 'done', 'result')
+    
+    def __init__(self, prepared, rois):
+        self.prepared = prepared
+        self.rois = rois
+        self.submitted = time.monotonic()
+        self.done = threading.Event()
+        self.result = None
+
+
+class BatchInferenceWorker:
+    """Single model thread serving several cameras, batching requests up to a deadline."""
+    
+    def __init__(self, classifier, max_batch=4, deadline_ms=50):
+        """
+        Initialize and start the worker.
+        
+        Args:
+            classifier: BlockageDetector or DetectorCascade (needs infer_batch)
+            max_batch: Requests per model call (usually the number of cameras)
+            deadline_ms: Longest a request waits for others to batch with
+        """
+        self.classifier = classifier
+        self.max_batch = max(1, max_batch)
+        self.deadline = deadline_ms / 1000
+        
+        self.requests = queue.Queue()
+        self.running = True
+        
+        self.batches = 0
+        self.batched_requests = 0
+        self.wait_time = 0.0
+        self.infer_time = 0.0
+        self.batch_sizes = {}
+        
+        self.thread = threading.Thread(target=self._run, name='BatchInference', daemon=True)
+        self.thread.start()
+    
+    def infer(self, prepared, rois=None, timeout=30):
+        """
+        Classify one prepare() output, batched with other callers.
+        
+        Blocks until the result is ready (called from a camera's infer stage).
+        
+        Returns:
+            Result dictionary (see BlockageDetector.detect)
+        """
+        if isinstance(prepared, dict):
+            return prepared  # Already decided (cascade screen)
+        
+        request = InferenceRequest(prepared, rois)
+        self.requests.put(request)
+        if not request.done.wait(timeout):
+            logger.error("Batched inference timed out")
+            return {'blocked': False, 'confidence': 0.0, 'class_name': 'unknown',
+                    'all_scores': {}, 'error': True}
+        return request.result
+    
+    def _collect(self):
+        """Block for one request, then gather more until the batch is full or the deadline passes."""
+        try:
+            first = self.requests.get(timeout=1)
+        except queue.Empty:
+            return []
+        
+        batch = [first]
+        deadline = first.submitted + self.deadline
+        while len(batch) < self.max_batch:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                break
+            try:
+                batch.append(self.requests.get(timeout=remaining))
+            except queue.Empty:
+                break
+        return batch
+    
+    def _run(self):
+        """Worker loop: collect, classify in one call, hand back results."""
+        while self.running:
+            batch = self._collect()
+            if not batch:
+                continue
+            
+            start = time.monotonic()
+            try:
+                results = self.classifier.infer_batch([(r.prepared, r.rois) for r in batch])
+            except Exception as e:
+                logger.error(f"Batched inference failed: {e}")
+                results = [{'blocked': False, 'confidence': 0.0, 'class_name': 'unknown',
+                            'all_scores': {}, 'error': True}] * len(batch)
+            end = time.monotonic()
+            
+            self.batches += 1
+            self.batched_requests += len(batch)
+            self.infer_time += end - start
+            self.wait_time += sum(start - r.submitted for r in batch)
+            self.batch_sizes[len(batch)] = self.batch_sizes.get(len(batch), 0) + 1
+            
+            for request, result in zip(batch, results):
+                request.result = result
+                request.done.set()
+    
+    def close(self):
+        """Stop the worker thread."""
+        self.running = False
+        self.thread.join(timeout=5)
+    
+    def get_stats(self):
+        """Batching metrics for the dashboard."""
+        return {
+            'max_batch': self.max_batch,
+            'deadline_ms': self.deadline * 1000,
+            'batches': self.batches,
+            'requests': self.batched_requests,
+            'mean_batch': self.batched_requests / self.batches if self.batches else 0.0,
+            'mean_wait_ms': self.wait_time / self.batched_requests * 1000 if self.batched_requests else None,
+            'mean_infer_ms': self.infer_time / self.batches * 1000 if self.batches else None,
+            'batch_sizes': dict(sorted(self.batch_sizes.items())),
+        }
+
+
+def test_batching():
+    """Four cameras share a model whose cost is mostly per call, not per image."""
+    import numpy as np
+    
+    print("Testing batched inference...")
+    
+    class SlowModel:
+        """20 ms per call plus 2 ms per image, like a small CNN on a CPU."""
+        def infer_batch(self, items):
+            time.sleep(0.020 + 0.002 * len(items))
+            return [{'class_name': 'clear', 'confidence': 1.0, 'camera': int(p[0, 0, 0])} for p, _ in items]
+    
+    def run(cameras, max_batch, frames=15):
+        worker = BatchInferenceWorker(SlowModel(), max_batch=max_batch, deadline_ms=30)
+        ok = []
+        
+        def camera(i):
+            tensor = np.full((96, 96, 3), i, dtype=np.uint8)
+            for _ in range(frames):
+                ok.append(worker.infer(tensor)['camera'] == i)
+        
+        threads = [threading.Thread(target=camera, args=(i,)) for i in range(cameras)]
+        start = time.monotonic()
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        elapsed = time.monotonic() - start
+        stats = worker.get_stats()
+        worker.close()
+        return cameras * frames / elapsed, stats, all(ok)
+    
+    single, _, ok1 = run(4, max_batch=1)
+    batched, stats, ok2 = run(4, max_batch=4)
+    print(f"  4 cameras, one call per frame: {single:.0f} frames/s")
+    print(f"  4 cameras, batched: {batched:.0f} frames/s, mean batch {stats['mean_batch']:.1f}, "
+          f"mean wait {stats['mean_wait_ms']:.1f} ms, sizes {stats['batch_sizes']}")
+    
+    ok = ok1 and ok2 and batched > 1.8 * single
+    print("Batching test PASSED" if ok else "Batching test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    test_batching()
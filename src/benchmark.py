@@ -0,0 +1,374 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Detection Benchmark
+
+Replays a directory of recorded captures through each detection path and
+reports per-stage latency percentiles, throughput and peak memory, so
+detection performance can be measured on the target and compared between
+commits instead of copied by hand:
+
+    python3 benchmark.py data/corpus --concurrency 2 --json results.json
+
+Paths:
+    mock     BlockageDetector without a model (brightness heuristic)
+    simple   SimpleBlockageDetector (OpenCV statistics, no AI)
+    eim      Edge Impulse .eim runner (models/drain_blockage.eim)
+    tflite   In-process TFLite runner (models/drain_blockage.tflite)
+
+Stages, timed separately for every image:
+    decode       JPEG bytes -> BGR at the size the path needs
+    preprocess   BGR -> model input tensor (model paths only)
+    infer        model invocation (or the simple detector's statistics)
+    postprocess  class scores -> result
+
+The corpus is read into memory first, so disk speed doesn't count. Each
+path runs in its own process so its peak RSS is its own. Paths whose
+runtime or model isn't available are reported as skipped.
+"""
+
+import argparse
+import json
+import logging
+import platform
+import resource
+import subprocess
+import sys
+import threading
+import time
+from pathlib import Path
+
+import cv2
+import numpy as np
+
+from ai_detector import EDGE_IMPULSE_AVAILABLE, TFLITE_AVAILABLE, BlockageDetector, SimpleBlockageDetector
+from jpeg_decode import decode_jpeg, jpeg_size
+
+logger = logging.getLogger('DrainSentinel.Benchmark')
+
+PATHS = ['mock', 'simple', 'eim', 'tflite']
+STAGES = ['decode', 'preprocess', 'infer', 'postprocess']
+IMAGE_SUFFIXES = ('.jpg', '.jpeg', '.png')
+
+
+def load_corpus(directory, limit=None):
+    """Encoded images under a directory (recursively), sorted by path."""
+    paths = sorted(p for p in Path(directory).rglob('*') if p.suffix.lower() in IMAGE_SUFFIXES)
+    if limit:
+        paths = paths[:limit]
+    return [p.read_bytes() for p in paths]
+
+
+def peak_rss_mb():
+    """Peak resident set size of this process."""
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # Kilobytes on Linux, bytes on macOS
+    return peak / 1024 / 1024 if sys.platform == 'darwin' else peak / 1024
+
+
+def percentiles(values):
+    """Latency summary (ms) of one stage."""
+    values = np.asarray(values)
+    p50, p99, p999 = np.percentile(values, [50, 99, 99.9])
+    return {
+        'p50': float(p50),
+        'p99': float(p99),
+        'p999': float(p999),
+        'mean': float(values.mean()),
+        'max': float(values.max()),
+    }
+
+
+class PathRunner:
+    """One detection path split into timed stages; one instance per worker thread."""
+    
+    def __init__(self, name, model_dir='models'):
+        """
+        Create the detector for a path.
+        
+        Raises:
+            RuntimeError: If the path's runtime or model isn't available
+        """
+        self.name = name
+        model_dir = Path(model_dir)
+        
+        if name == 'simple':
+            self.detector = SimpleBlockageDetector()
+            self.size = self.detector.ANALYSIS_SIZE
+            return
+        
+        if name == 'mock':
+            # No model file: the detector falls back to its mock
+            self.detector = BlockageDetector(model_dir / 'benchmark-mock', cache=False)
+        elif name == 'eim':
+            model_path = model_dir / 'drain_blockage.eim'
+            if not EDGE_IMPULSE_AVAILABLE or not model_path.exists():
+                raise RuntimeError(f"needs the Edge Impulse SDK and {model_path}")
+            self.detector = BlockageDetector(model_path, cache=False)
+            if self.detector.runner is None:
+                raise RuntimeError(f"{model_path} failed to load")
+        elif name == 'tflite':
+            model_path = model_dir / 'drain_blockage.tflite'
+            if not TFLITE_AVAILABLE or not model_path.exists():
+                raise RuntimeError(f"needs a TFLite runtime and {model_path}")
+            self.detector = BlockageDetector(model_path, cache=False)
+            if self.detector.tflite is None:
+                raise RuntimeError(f"{model_path} failed to load")
+        else:
+            raise ValueError(f"Unknown detection path: {name}")
+        self.size = self.detector.input_size
+    
+    def run(self, data):
+        """
+        Detect one encoded image.
+        
+        Returns:
+            ({stage: ms}, result)
+        """
+        timing = {}
+        start = time.perf_counter()
+        image = decode_jpeg(data, self.size)
+        if image is None:
+            raise ValueError("undecodable image")
+        now = time.perf_counter()
+        timing['decode'] = now - start
+        
+        if self.name == 'simple':
+            start = now
+            # analyze() needs to know how much the reduced-scale decode shrank the frame
+            full_width = (jpeg_size(data) or (image.shape[1],))[0]
+            stats = self.detector.analyze(image, full_width / image.shape[1])
+            now = time.perf_counter()
+            timing['infer'] = now - start
+            start = now
+            result = {'score': self.detector.score(*stats)}
+            timing['postprocess'] = time.perf_counter() - start
+            return {stage: t * 1000 for stage, t in timing.items()}, result
+        
+        detector = self.detector
+        start = now
+        tensor = detector.preprocess_array(image)
+        now = time.perf_counter()
+        timing['preprocess'] = now - start
+        
+        start = now
+        if detector.tflite is not None:
+            scores, model_timing = detector.tflite.classify(tensor)
+            now = time.perf_counter()
+            timing['infer'] = now - start
+            start = now
+            result = detector._scores_result(scores[0], model_timing)
+            timing['postprocess'] = time.perf_counter() - start
+        elif detector.runner is not None:
+            features = detector.runner.get_features_from_image(tensor)
+            response = detector.runner.classify(features)
+            now = time.perf_counter()
+            timing['infer'] = now - start
+            start = now
+            result = detector._scores_result(response['result']['classification'],
+                                             {'invoke': response['timing']['classification']})
+            timing['postprocess'] = time.perf_counter() - start
+        else:
+            # The mock decides in one step
+            result = detector._mock_detect(tensor)
+            timing['infer'] = time.perf_counter() - start
+        return {stage: t * 1000 for stage, t in timing.items()}, result
+    
+    def close(self):
+        if hasattr(self.detector, 'close'):
+            self.detector.close()
+
+
+def run_path(name, corpus, concurrency=1, repeat=1, warmup=2, model_dir='models'):
+    """
+    Benchmark one detection path in this process.
+    
+    Args:
+        name: Path name (see PATHS)
+        corpus: List of encoded images
+        concurrency: Worker threads, each with its own detector
+        repeat: Times the corpus is replayed
+        warmup: Images per worker run before timing starts
+    
+    Returns:
+        Results dictionary (per-stage percentiles, throughput, peak RSS),
+        or {'skipped': reason}
+    """
+    try:
+        runners = [PathRunner(name, model_dir) for _ in range(concurrency)]
+    except RuntimeError as e:
+        return {'skipped': str(e)}
+    
+    for runner in runners:
+        for data in corpus[:warmup]:
+            runner.run(data)
+    
+    # Workers take the next image from a shared counter (fixed concurrency)
+    jobs = corpus * repeat
+    timings = {stage: [] for stage in STAGES}
+    totals = []
+    errors = []
+    lock = threading.Lock()
+    next_job = [0]
+    
+    def worker(runner):
+        while True:
+            with lock:
+                i = next_job[0]
+                next_job[0] += 1
+            if i >= len(jobs):
+                return
+            try:
+                timing, _ = runner.run(jobs[i])
+            except Exception as e:
+                errors.append(str(e))
+                continue
+            for stage, ms in timing.items():
+                timings[stage].append(ms)
+            totals.append(sum(timing.values()))
+    
+    threads = [threading.Thread(target=worker, args=(runner,)) for runner in runners]
+    start = time.perf_counter()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.perf_counter() - start
+    
+    for runner in runners:
+        runner.close()
+    
+    return {
+        'images': len(totals),
+        'errors': len(errors),
+        'concurrency': concurrency,
+        'wall_s': elapsed,
+        'images_per_s': len(totals) / elapsed if elapsed else None,
+        'stages': {stage: percentiles(values) for stage, values in timings.items() if values},
+        'total': percentiles(totals) if totals else None,
+        'peak_rss_mb': peak_rss_mb(),
+    }
+
+
+def git_commit():
+    """Short hash of the checked-out commit, if this is a git checkout."""
+    try:
+        return subprocess.run(['git', 'rev-parse', '--short', 'HEAD'], capture_output=True, text=True,
+                              cwd=Path(__file__).parent, timeout=5).stdout.strip() or None
+    except (OSError, subprocess.SubprocessError):
+        return None
+
+
+def run_isolated(name, args):
+    """Run one path in a child process (so peak RSS is per path)."""
+    command = [sys.executable, __file__, str(args.corpus), '--paths', name,
+               '--concurrency', str(args.concurrency), '--repeat', str(args.repeat),
+               '--warmup', str(args.warmup), '--model-dir', str(args.model_dir), '--json', '-']
+    if args.limit:
+        command += ['--limit', str(args.limit)]
+    child = subprocess.run(command, capture_output=True, text=True)
+    if child.returncode != 0:
+        return {'skipped': f"benchmark process failed: {child.stderr.strip().splitlines()[-1:]}"}
+    return json.loads(child.stdout)['paths'][name]
+
+
+def print_report(report):
+    """Human-readable table of a benchmark report."""
+    print(f"Corpus {report['corpus']}: {report['corpus_images']} images, commit {report['commit']}, "
+          f"{report['machine']}")
+    for name, results in report['paths'].items():
+        if 'skipped' in results:
+            print(f"\n{name}: skipped ({results['skipped']})")
+            continue
+        print(f"\n{name}: {results['images']} images at concurrency {results['concurrency']}, "
+              f"{results['images_per_s']:.1f} images/s, peak RSS {results['peak_rss_mb']:.0f} MB"
+              + (f", {results['errors']} errors" if results['errors'] else ''))
+        print(f"  {'stage':<12} {'p50':>9} {'p99':>9} {'p999':>9} {'max':>9}  (ms)")
+        for stage, summary in list(results['stages'].items()) + [('total', results['total'])]:
+            print(f"  {stage:<12} {summary['p50']:9.2f} {summary['p99']:9.2f} "
+                  f"{summary['p999']:9.2f} {summary['max']:9.2f}")
+
+
+def test_benchmark():
+    """Run the mock and simple paths over a small synthetic corpus."""
+    import shutil
+    import tempfile
+    
+    print("Testing benchmark...")
+    
+    directory = Path(tempfile.mkdtemp())
+    try:
+        y, x = np.mgrid[0:720, 0:1280]
+        for i in range(6):
+            base = 120 + 50 * np.sin(x / (30.0 + i)) * np.cos(y / 23.0)
+            image = np.clip(np.dstack([base, base * 0.9, base * 0.8]), 0, 255).astype(np.uint8)
+            cv2.imwrite(str(directory / f"{i}.jpg"), image)
+        corpus = load_corpus(directory)
+    finally:
+        shutil.rmtree(directory)
+    
+    ok = len(corpus) == 6
+    for name in ('mock', 'simple'):
+        results = run_path(name, corpus, concurrency=2, repeat=5)
+        stages = results['stages']
+        print(f"  {name}: {results['images']} images, {results['images_per_s']:.0f} images/s, "
+              f"total p50 {results['total']['p50']:.2f} ms, p99 {results['total']['p99']:.2f} ms")
+        ok &= results['images'] == 30 and results['errors'] == 0
+        ok &= set(stages) == ({'decode', 'infer', 'postprocess'} if name == 'simple' else
+                              {'decode', 'preprocess', 'infer'})
+        ok &= all(s['p50'] <= s['p99'] <= s['p999'] <= s['max'] for s in stages.values())
+    ok &= 'skipped' in run_path('tflite', corpus, model_dir='/nonexistent')
+    
+    print("Benchmark test PASSED" if ok else "Benchmark test FAILED")
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='DrainSentinel detection benchmark')
+    parser.add_argument('corpus', nargs='?', help='Directory of recorded captures (omit to self-test)')
+    parser.add_argument('--paths', default=','.join(PATHS), help=f"Comma-separated, from {PATHS}")
+    parser.add_argument('--concurrency', type=int, default=1, help='Worker threads per path')
+    parser.add_argument('--repeat', type=int, default=3, help='Times the corpus is replayed')
+    parser.add_argument('--warmup', type=int, default=2, help='Untimed images per worker')
+    parser.add_argument('--limit', type=int, help='Use only the first N images')
+    parser.add_argument('--model-dir', default='models', help='Directory with the model files')
+    parser.add_argument('--json', help="Write results as JSON to this file ('-' for stdout)")
+    args = parser.parse_args()
+    
+    logging.basicConfig(level=logging.WARNING)
+    if args.corpus is None:
+        test_benchmark()
+        sys.exit(0)
+    
+    corpus = load_corpus(args.corpus, args.limit)
+    if not corpus:
+        sys.exit(f"No images found in {args.corpus}")
+    
+    names = [name.strip() for name in args.paths.split(',') if name.strip()]
+    unknown = set(names) - set(PATHS)
+    if unknown:
+        sys.exit(f"Unknown paths: {sorted(unknown)}")
+    
+    report = {
+        'commit': git_commit(),
+        'timestamp': time.time(),
+        'machine': f"{platform.machine()} {platform.system()} {platform.release()}, "
+                   f"Python {platform.python_version()}, OpenCV {cv2.__version__}",
+        'corpus': str(args.corpus),
+        'corpus_images': len(corpus),
+        'repeat': args.repeat,
+        'paths': {},
+    }
+    for name in names:
+        if len(names) == 1:
+            report['paths'][name] = run_path(name, corpus, args.concurrency, args.repeat,
+                                             args.warmup, args.model_dir)
+        else:
+            report['paths'][name] = run_isolated(name, args)
+    
+    if args.json == '-':
+        print(json.dumps(report, indent=2))
+    else:
+        print_report(report)
+        if args.json:
+            with open(args.json, 'w') as f:
+                json.dump(report, f, indent=2)
+            print(f"\nResults saved to: {args.json}")
@@ -46,6 +46,55 @@ def get_float_input(prompt, default=None):
             print("Please enter a valid number.")
 
 
+def define_rois(image=None):
+    """
+    Ask for the detection regions (the drain inlet area).
+    
+    Regions are drawn on the test photo when a display is available,
+    otherwise typed in as fractions of the frame.
+    
+    Args:
+        image: Test photo (BGR) to draw on, or None
+    
+    Returns:
+        List of ROI dictionaries for calibration.json (empty: whole frame)
+    """
+    from roi import RegionOfInterest
+    
+    rois = []
+    if image is not None and os.environ.get('DISPLAY'):
+        try:
+            import cv2
+            print("Draw a box around each drain inlet area in the window.")
+            print("Press Enter/Space after each box, then Esc when done.")
+            boxes = cv2.selectROIs("DrainSentinel detection regions", image)
+            cv2.destroyAllWindows()
+            h, w = image.shape[:2]
+            for x, y, bw, bh in boxes:
+                roi = RegionOfInterest(f"roi{len(rois)}", [[x / w, y / h], [(x + bw) / w, (y + bh) / h]])
+                rois.append(roi.to_dict())
+            return rois
+        except Exception as e:
+            print(f"Could not open the drawing window: {e}")
+    
+    print("Enter each region as fractions of the frame (0-1, origin top-left):")
+    print("  rectangle: x0,y0 x1,y1")
+    print("  polygon:   x0,y0 x1,y1 x2,y2 ...")
+    print("Leave blank to use the whole frame / finish.")
+    while True:
+        line = input(f"Region {len(rois) + 1}: ").strip()
+        if not line:
+            break
+        try:
+            points = [[float(v) for v in point.split(',')] for point in line.split()]
+            kind = 'rect' if len(points) == 2 else 'polygon'
+            rois.append(RegionOfInterest(f"roi{len(rois)}", points, kind).to_dict())
+        except ValueError as e:
+            print(f"Invalid region: {e}")
+    
+    return rois
+
+
 def run_calibration():
     """Run the interactive calibration wizard."""
     clear_screen()
@@ -190,6 +239,7 @@ def run_calibration():
     print("-" * 40)
     print()
     
+    photo = None
     try:
         from camera import Camera
         camera = Camera()
@@ -200,6 +250,8 @@ def run_calibration():
         if path:
             print(f"Photo saved to: {path}")
             print("\nPlease verify the camera has a good view of the drain.")
+            import cv2
+            photo = cv2.imread(path)
         else:
             print("Failed to capture photo. Check camera connection.")
         
@@ -207,6 +259,12 @@ def run_calibration():
     except Exception as e:
         print(f"Camera test skipped: {e}")
     
+    print()
+    print("Detection regions: blockage detection can be limited to the")
+    print("drain inlet, giving the model a closer view of the grate.")
+    print()
+    calibration['rois'] = define_rois(photo)
+    
     print()
     wait_for_enter()
     
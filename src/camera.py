@@ -3,42 +3,84 @@
 DrainSentinel: Camera Module
 
 Handles camera capture and image preprocessing for the blockage detection system.
-Supports USB cameras on Raspberry Pi.
+Supports USB cameras on Raspberry Pi. On Linux, frames are read directly
+through V4L2 (see v4l2_capture.py), falling back to OpenCV elsewhere.
 """
 
 import cv2
 import logging
+import numpy as np
 import os
-from datetime import datetime
+import time
 from pathlib import Path
 
+from capture_store import CaptureStore
+from frame import Frame, FrameBroadcaster
+from preprocess import Preprocessor
+from v4l2_capture import V4L2Capture
+
 logger = logging.getLogger('DrainSentinel.Camera')
 
 
 class Camera:
     """Camera capture and image management."""
     
-    def __init__(self, device_id=0, resolution=(1280, 720)):
+    def __init__(self, device_id=0, resolution=(1280, 720), backend='auto', pixel_format='MJPG',
+                 capture_dir='data/captures', store_options=None):
         """
         Initialize the camera.
         
         Args:
             device_id: Camera device ID (usually 0 for first USB camera)
             resolution: Capture resolution (width, height)
+            backend: 'v4l2', 'opencv', or 'auto' (V4L2 when the device node
+                exists, otherwise OpenCV)
+            pixel_format: V4L2 pixel format, 'MJPG' or 'YUYV'
+            capture_dir: Where saved captures (and latest.jpg) go; each
+                camera at a multi-inlet site needs its own
+            store_options: CaptureStore settings (capacity_mb, max_age, ...)
         """
         self.device_id = device_id
         self.resolution = resolution
-        self.capture_dir = Path('data/captures')
+        self.backend = backend
+        self.pixel_format = pixel_format
+        self.capture_dir = Path(capture_dir)
         self.capture_dir.mkdir(parents=True, exist_ok=True)
         
+        # Capture ring with background writer (opened on first save_async)
+        self.store = None
+        self.store_options = store_options or {}
+        self.sequence = 0
+        
+        # Single capture thread (created by start_broadcast)
+        self.broadcaster = None
+        self.ai_preprocessor = None
+        
         # Initialize camera
         self.cap = None
         self._init_camera()
         
-        logger.info(f"Camera initialized: device {device_id}, resolution {resolution}")
+        logger.info(f"Camera initialized: device {device_id}, resolution {resolution}, "
+                    f"backend {self.backend}")
     
     def _init_camera(self):
         """Initialize the camera capture object."""
+        device = f"/dev/video{self.device_id}"
+        if self.backend == 'v4l2' or (self.backend == 'auto' and os.path.exists(device)):
+            try:
+                self.cap = V4L2Capture(device, self.resolution, self.pixel_format)
+                self.backend = 'v4l2'
+                logger.info(f"Camera actual resolution: ({self.cap.width}, {self.cap.height}), "
+                            f"format {self.pixel_format}")
+                return
+            except Exception as e:
+                if self.backend == 'v4l2':
+                    logger.error(f"Camera initialization failed: {e}")
+                    self.cap = None
+                    raise
+                logger.warning(f"V4L2 capture unavailable ({e}), falling back to OpenCV")
+        
+        self.backend = 'opencv'
         try:
             self.cap = cv2.VideoCapture(self.device_id)
             
@@ -57,7 +99,7 @@ class Camera:
             actual_res = (int(self.cap.get(cv2.CAP_PROP_FRAME_WIDTH)),
                          int(self.cap.get(cv2.CAP_PROP_FRAME_HEIGHT)))
             logger.info(f"Camera actual resolution: {actual_res}")
-            
+        
         except Exception as e:
             logger.error(f"Camera initialization failed: {e}")
             self.cap = None
@@ -68,109 +110,194 @@ class Camera:
         Capture a single frame from the camera.
         
         Args:
-            save: Whether to save the image to disk
+            save: Whether to store the image in the capture ring
             
         Returns:
-            Path to saved image, or None if capture failed
+            Path of latest.jpg once the capture is stored (or the BGR image
+            when save is False), or None if capture failed
         """
+        captured = self.capture_frame()
+        if captured is None:
+            return None
+        
+        try:
+            # MJPEG frames are decoded here; a corrupt one raises
+            frame = captured.image
+            
+            if save:
+                # Through the ring like every other capture: its writer
+                # replaces latest.jpg atomically (left as is for a duplicate)
+                capture_id = self.save_async(captured)
+                self.store.flush()
+                if capture_id is None or self.store.get(capture_id) is None:
+                    logger.error("Failed to store capture")
+                    return None
+                logger.debug(f"Captured image: {capture_id}")
+                return str(self.capture_dir / 'latest.jpg')
+            else:
+                return frame
+        
+        except Exception as e:
+            logger.error(f"Capture failed: {e}")
+            return None
+    
+    def start_broadcast(self, max_fps=15):
+        """
+        Move all device reads onto one capture thread.
+        
+        Afterwards every capture method returns the latest broadcast frame
+        instead of reading the device itself, so detection and any number
+        of stream viewers share frames rather than competing for them.
+        
+        Args:
+            max_fps: Capture rate limit
+        """
+        if self.broadcaster is None:
+            self.broadcaster = FrameBroadcaster(self._read_frame, max_fps=max_fps,
+                                                name='CameraCapture')
+            logger.info(f"Camera broadcasting at up to {max_fps} fps")
+    
+    def capture_frame(self):
+        """
+        Capture a single frame into memory.
+        
+        Returns:
+            Frame, or None if capture failed
+        """
+        if self.broadcaster is not None:
+            frame = self.broadcaster.latest()
+            if frame is None:
+                _, frame = self.broadcaster.wait(timeout=2.0)
+            return frame
+        return self._read_frame()
+    
+    def wait_frame(self, after=0, timeout=1.0):
+        """
+        Wait for a broadcast frame newer than the given broadcast sequence.
+        
+        Without a broadcaster, reads the device directly.
+        
+        Returns:
+            (sequence, Frame), or (after, None) if no new frame arrived
+        """
+        if self.broadcaster is not None:
+            return self.broadcaster.wait(after, timeout)
+        frame = self._read_frame()
+        return (after + 1, frame) if frame is not None else (after, None)
+    
+    def _read_frame(self):
+        """Read the next frame from the device."""
         if self.cap is None or not self.cap.isOpened():
             logger.error("Camera not available")
             return None
         
         try:
-            # Capture frame
-            ret, frame = self.cap.read()
+            if self.backend == 'v4l2':
+                # Driver capture time; MJPEG stays encoded until someone needs pixels
+                result = self.cap.read_frame()
+                if result is None:
+                    logger.error("Failed to capture frame")
+                    return None
+                data, timestamp, _ = result
+                self.sequence += 1
+                if isinstance(data, bytes):
+                    return Frame(None, timestamp, self.sequence, self.device_id, jpeg=data)
+                return Frame(data, timestamp, self.sequence, self.device_id)
+            
+            ret, image = self.cap.read()
+            timestamp = time.time()
             
-            if not ret or frame is None:
+            if not ret or image is None:
                 logger.error("Failed to capture frame")
                 return None
             
-            if save:
-                # Generate filename with timestamp
-                timestamp = datetime.now().strftime('%Y%m%d_%H%M%S')
-                filename = f"capture_{timestamp}.jpg"
-                filepath = self.capture_dir / filename
-                
-                # Save image
-                cv2.imwrite(str(filepath), frame)
-                logger.debug(f"Captured image: {filepath}")
-                
-                # Also save as "latest.jpg" for dashboard
-                latest_path = self.capture_dir / 'latest.jpg'
-                cv2.imwrite(str(latest_path), frame)
-                
-                return str(filepath)
-            else:
-                return frame
-            
+            self.sequence += 1
+            return Frame(image, timestamp, self.sequence, self.device_id)
+        
         except Exception as e:
             logger.error(f"Capture failed: {e}")
             return None
     
+    def save_async(self, frame):
+        """
+        Store a frame in the capture ring on the background writer thread.
+        
+        Args:
+            frame: Frame from capture_frame()
+        
+        Returns:
+            Capture id (see CaptureStore), or None if it was dropped
+        """
+        if self.store is None:
+            self.store = CaptureStore(self.capture_dir, **self.store_options)
+        return self.store.submit(frame)
+    
     def capture_for_ai(self, target_size=(224, 224)):
         """
         Capture and preprocess image for AI model.
         
         Args:
             target_size: Size to resize image to (width, height)
-            
+        
         Returns:
             Preprocessed numpy array, or None if failed
         """
-        frame = self.capture(save=False)
+        frame = self.capture_frame()
         
         if frame is None:
             return None
         
         try:
-            # Resize for AI model
-            resized = cv2.resize(frame, target_size)
-            
-            # Convert BGR to RGB (OpenCV uses BGR by default)
-            rgb = cv2.cvtColor(resized, cv2.COLOR_BGR2RGB)
-            
-            # Normalize to 0-1 range
-            normalized = rgb.astype('float32') / 255.0
-            
-            return normalized
-            
+            # Resize, BGR->RGB and 0-1 normalization in one pass
+            if self.ai_preprocessor is None or self.ai_preprocessor.size != tuple(target_size):
+                self.ai_preprocessor = Preprocessor(target_size, np.float32)
+            return self.ai_preprocessor(frame.image)
+        
         except Exception as e:
             logger.error(f"Image preprocessing failed: {e}")
             return None
     
-    def get_stream_frame(self):
+    def get_stream_frame(self, frame=None):
         """
         Get a frame for live streaming (JPEG encoded).
         
+        Args:
+            frame: Frame to encode; defaults to the latest capture
+        
         Returns:
             JPEG encoded bytes, or None if failed
         """
-        if self.cap is None or not self.cap.isOpened():
-            return None
+        if frame is None:
+            frame = self.capture_frame()
+            if frame is None:
+                return None
+        frame = frame.image
         
         try:
-            ret, frame = self.cap.read()
-            if not ret:
-                return None
-            
             # Resize for streaming (lower resolution for bandwidth)
             stream_size = (640, 480)
             resized = cv2.resize(frame, stream_size)
             
             # Encode as JPEG
-            ret, jpeg = cv2.imencode('.jpg', resized, 
+            ret, jpeg = cv2.imencode('.jpg', resized,
                                       [cv2.IMWRITE_JPEG_QUALITY, 70])
             if not ret:
                 return None
             
             return jpeg.tobytes()
-            
+        
         except Exception as e:
             logger.error(f"Stream frame failed: {e}")
             return None
     
     def release(self):
         """Release camera resources."""
+        if self.broadcaster is not None:
+            self.broadcaster.close()
+            self.broadcaster = None
+        if self.store is not None:
+            self.store.close()
+            self.store = None
         if self.cap is not None:
             self.cap.release()
             logger.info("Camera released")
@@ -199,7 +326,7 @@ def test_camera():
             print("Camera test FAILED")
         
         cam.release()
-        
+    
     except Exception as e:
         print(f"Camera test FAILED: {e}")
 
@@ -0,0 +1,825 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Capture Ring Store
+
+Stored camera captures live in a fixed number of preallocated segment
+files instead of one JPEG file per capture, so the disk budget is set
+once and never exceeded, and the SD card sees large sequential writes
+into space that is already allocated:
+
+    ring/seg_000.bin ... seg_NNN.bin   SEGMENT_HEADER, then JPEGs back to back
+    ring/index.bin                     one INDEX_RECORD per stored capture
+    ring/pinned/                       captures kept beyond the ring
+    ring/pins.json                     pinned time ranges
+
+Captures are appended to the current segment; when it is full the writer
+moves on to the next one, bumping its generation, which evicts everything
+stored there before. Index records carry the generation they were written
+under, so records for recycled segments are recognised as stale without
+rewriting the index. The index is append-only and only rewritten when
+stale records outnumber live ones.
+
+Retention:
+- size: the ring capacity (segment count x segment size)
+- age: captures older than max_age are dropped from the index
+- pinning: captures inside a pinned time range (e.g. around an alert) are
+  copied to pinned/ before their segment is recycled, and kept there for
+  pinned_max_age, within their own size budget. Deduplicated captures
+  sharing one stored JPEG share one pinned copy too.
+
+Deduplication: most consecutive captures of a quiet drain are the same
+picture. Each frame's 64-bit dhash (see change_gate.py) is compared with
+that of the last frame actually stored; when fewer than dedup_bits
+differ, only an index record pointing at the stored frame's bytes is
+written (and latest.jpg is left alone), so the timeline stays complete
+while the JPEG is written once. A full frame is still stored at least
+every keyframe_interval, so slow changes the hash ignores (daylight) are
+kept.
+
+Capture ids are '<timestamp ms>-<camera sequence>', unique per camera.
+Writes happen on a background thread, like the frame writer they replace.
+
+Stored captures are read back through find()/get()/read(), by the
+dashboard's /api/captures routes, and by the export command, which opens
+the ring read-only next to a running gateway:
+
+    python3 capture_store.py export --start 2026-10-17T06:00 --end 2026-10-17T09:00 exported/
+"""
+
+import argparse
+import bisect
+import json
+import logging
+import os
+import queue
+import struct
+import threading
+import time
+from collections import Counter
+from datetime import datetime
+from pathlib import Path
+
+import cv2
+
+from change_gate import dhash, hamming
+
+logger = logging.getLogger('DrainSentinel.Captures')
+
+# magic, version, segment number, generation
+SEGMENT_HEADER = struct.Struct('<4sHHI')
+SEGMENT_MAGIC = b'DSCR'
+SEGMENT_VERSION = 1
+
+# timestamp ms, sequence, generation, offset, length, segment, flags. For a
+# pinned capture, generation and offset instead name the pinned/ file holding
+# its data: the sequence and how many ms earlier it was taken
+INDEX_RECORD = struct.Struct('<qIIIIHH')
+
+FLAG_PINNED = 1           # Data lives in pinned/, not in a segment
+FLAG_DUPLICATE = 2        # Points at an earlier capture's data
+PINNED_SEGMENT = 0xFFFF
+
+
+class CaptureRecord:
+    """Where one stored capture lives."""
+    
+    __slots__ = ('timestamp_ms', 'sequence', 'generation', 'offset', 'length', 'segment', 'flags')
+    
+    def __init__(self, timestamp_ms, sequence, generation, offset, length, segment, flags=0):
+        self.timestamp_ms = timestamp_ms
+        self.sequence = sequence
+        self.generation = generation
+        self.offset = offset
+        self.length = length
+        self.segment = segment
+        self.flags = flags
+    
+    @property
+    def id(self):
+        return f"{self.timestamp_ms}-{self.sequence}"
+    
+    @property
+    def timestamp(self):
+        return self.timestamp_ms / 1000
+    
+    @property
+    def pinned(self):
+        return bool(self.flags & FLAG_PINNED)
+    
+    @property
+    def duplicate(self):
+        return bool(self.flags & FLAG_DUPLICATE)
+    
+    def pack(self):
+        return INDEX_RECORD.pack(self.timestamp_ms, self.sequence, self.generation,
+                                 self.offset, self.length, self.segment, self.flags)
+    
+    def __repr__(self):
+        where = 'pinned' if self.pinned else f"segment {self.segment}+{self.offset}"
+        if self.duplicate:
+            where += ', duplicate'
+        return f"CaptureRecord({self.id}, {self.length} bytes, {where})"
+
+
+class CaptureStore:
+    """Preallocated ring of captures with a time index, retention and pinning."""
+    
+    def __init__(self, directory, capacity_mb=512, segment_mb=16, max_age=72 * 3600,
+                 pinned_mb=256, pinned_max_age=30 * 86400, dedup_bits=3, keyframe_interval=3600,
+                 max_queue=4, quality=95, write_latest=True, read_only=False):
+        """
+        Open (or create) the store.
+        
+        Args:
+            directory: Camera capture directory; the ring goes in ring/ below
+                it and latest.jpg next to it
+            capacity_mb: Ring size on disk (rounded down to whole segments)
+            segment_mb: Segment size; one segment is evicted at a time
+            max_age: Seconds a capture is kept (unless pinned)
+            pinned_mb: Disk budget for pinned captures (oldest go first)
+            pinned_max_age: Seconds pinned captures and pins are kept
+            dedup_bits: dhash bits (of 64) a frame must differ by from the
+                last stored one to be stored itself; None stores every frame
+            keyframe_interval: Store a full frame at least this often (seconds)
+            max_queue: Frames waiting to be written; newer frames are
+                dropped when the disk can't keep up
+            quality: JPEG quality for frames that arrive as pixels
+            write_latest: Also refresh latest.jpg for the dashboard
+            read_only: Only read an existing ring (e.g. one a running
+                gateway writes); its size is taken from the segment files
+        """
+        self.directory = Path(directory)
+        self.ring_dir = self.directory / 'ring'
+        self.pinned_dir = self.ring_dir / 'pinned'
+        self.read_only = read_only
+        if read_only:
+            segments = sorted(self.ring_dir.glob('seg_*.bin'))
+            if not segments:
+                raise FileNotFoundError(f"No capture ring in {self.directory}")
+            self.segment_bytes = segments[0].stat().st_size
+            self.segment_count = len(segments)
+            segment_mb = self.segment_bytes / 1024 / 1024
+        else:
+            self.pinned_dir.mkdir(parents=True, exist_ok=True)
+            self.segment_bytes = int(segment_mb * 1024 * 1024)
+            self.segment_count = max(2, int(capacity_mb // segment_mb))
+        self.max_age = max_age
+        self.pinned_bytes_limit = int(pinned_mb * 1024 * 1024)
+        self.pinned_max_age = pinned_max_age
+        self.dedup_bits = dedup_bits
+        self.keyframe_interval = keyframe_interval
+        self.quality = quality
+        self.write_latest = write_latest
+        
+        # Last frame stored in full, and its hash
+        self.keyframe = None
+        self.keyframe_hash = None
+        
+        # Index, sorted by time; readers take the lock, the writer holds it to change it
+        self.lock = threading.RLock()
+        self.records = []
+        self.times = []
+        self.pins = []
+        self.pinned_bytes = 0
+        
+        self.written = 0
+        self.bytes_written = 0
+        self.duplicates = 0
+        self.bytes_saved = 0
+        self.dropped = 0
+        self.evicted = 0
+        self.expired = 0
+        
+        self._open_segments()
+        self._load_pins()
+        self._load_index()
+        
+        self.queue = queue.Queue(maxsize=max_queue)
+        self.thread = threading.Thread(target=self._write_loop, name='CaptureWriter', daemon=True)
+        if not read_only:
+            self.thread.start()
+        
+        logger.info(f"Capture store {self.ring_dir}: {self.segment_count} x {segment_mb} MB segments, "
+                    f"{len(self.records)} captures indexed")
+    
+    # --- Disk layout ---
+    
+    def _open_segments(self):
+        """Open every segment file, preallocating missing or resized ones."""
+        self.fds = []
+        self.generations = []
+        for number in range(self.segment_count):
+            path = self.ring_dir / f"seg_{number:03d}.bin"
+            fd = os.open(path, os.O_RDONLY if self.read_only else os.O_RDWR | os.O_CREAT, 0o644)
+            header = os.pread(fd, SEGMENT_HEADER.size, 0)
+            
+            generation = 0
+            valid = os.fstat(fd).st_size == self.segment_bytes and len(header) == SEGMENT_HEADER.size
+            if valid:
+                magic, version, stored_number, generation = SEGMENT_HEADER.unpack(header)
+                valid = magic == SEGMENT_MAGIC and version == SEGMENT_VERSION and stored_number == number
+            if not valid and self.read_only:
+                generation = -1  # Matches no record
+            elif not valid:
+                # New or resized: anything the index says about it is stale
+                os.ftruncate(fd, 0)
+                if hasattr(os, 'posix_fallocate'):
+                    os.posix_fallocate(fd, 0, self.segment_bytes)
+                else:
+                    os.ftruncate(fd, self.segment_bytes)
+                generation += 1
+                os.pwrite(fd, SEGMENT_HEADER.pack(SEGMENT_MAGIC, SEGMENT_VERSION, number, generation), 0)
+            
+            self.fds.append(fd)
+            self.generations.append(generation)
+        
+        self.segment = 0
+        self.position = SEGMENT_HEADER.size
+    
+    def _load_index(self):
+        """Rebuild the in-memory index from index.bin, dropping stale records."""
+        self.index_path = self.ring_dir / 'index.bin'
+        latest = {}
+        last_stored = None
+        try:
+            data = self.index_path.read_bytes()
+        except FileNotFoundError:
+            data = b''
+        
+        # A record written again (moved to pinned/) supersedes the earlier one
+        usable = len(data) - len(data) % INDEX_RECORD.size
+        for fields in INDEX_RECORD.iter_unpack(data[:usable]):
+            record = CaptureRecord(*fields)
+            latest[(record.timestamp_ms, record.sequence)] = record
+            if not record.pinned:
+                last_stored = record
+        self.index_records = usable // INDEX_RECORD.size
+        
+        now = time.time()
+        live = [r for r in latest.values() if self._valid(r) and not self._is_expired(r, now)]
+        live.sort(key=lambda r: r.timestamp_ms)
+        self.records = live
+        self.times = [r.timestamp_ms for r in live]
+        self.pinned_bytes = sum({self._pinned_path(r): r.length for r in live if r.pinned}.values())
+        
+        # Resume writing after the last capture stored in the ring
+        if last_stored is not None and self._valid(last_stored):
+            self.segment = last_stored.segment
+            self.position = last_stored.offset + last_stored.length
+        
+        if self.read_only:
+            return
+        self.index_file = open(self.index_path, 'ab')
+        if usable != len(data):
+            self.index_file.truncate(usable)  # Torn last record from a crash
+        if self.index_records > 2 * len(self.records) + 256:
+            self._compact_index()
+    
+    def _valid(self, record):
+        """Whether a record still points at its data."""
+        if record.pinned:
+            return self._pinned_path(record).exists()
+        return (record.segment < self.segment_count
+                and record.generation == self.generations[record.segment]
+                and record.offset + record.length <= self.segment_bytes)
+    
+    def _pinned_path(self, record):
+        return self.pinned_dir / f"{record.timestamp_ms - record.offset}-{record.generation}.jpg"
+    
+    def _compact_index(self):
+        """Rewrite index.bin with only the live records."""
+        tmp_path = self.index_path.with_suffix('.tmp')
+        with open(tmp_path, 'wb') as f:
+            f.write(b''.join(r.pack() for r in self.records))
+        self.index_file.close()
+        os.replace(tmp_path, self.index_path)
+        self.index_file = open(self.index_path, 'ab')
+        logger.debug(f"Compacted capture index from {self.index_records} to {len(self.records)} records")
+        self.index_records = len(self.records)
+    
+    def _write_record(self, record):
+        self.index_file.write(record.pack())
+        self.index_file.flush()
+        self.index_records += 1
+    
+    # --- Pins ---
+    
+    def _load_pins(self):
+        try:
+            with open(self.ring_dir / 'pins.json') as f:
+                self.pins = [tuple(pin) for pin in json.load(f)]
+        except (OSError, ValueError):
+            self.pins = []
+    
+    def _save_pins(self):
+        tmp_path = self.ring_dir / 'pins.json.tmp'
+        with open(tmp_path, 'w') as f:
+            json.dump(self.pins, f)
+        os.replace(tmp_path, self.ring_dir / 'pins.json')
+    
+    def pin(self, start, end):
+        """
+        Keep every capture between two times beyond the ring's retention.
+        
+        The range may extend into the future (captures stored later are
+        pinned too). Pinned captures are kept for pinned_max_age.
+        """
+        with self.lock:
+            self.pins.append((float(start), float(end)))
+            self._save_pins()
+        logger.info(f"Pinned captures from {time.ctime(start)} to {time.ctime(end)}")
+    
+    def _is_pinned(self, timestamp_ms):
+        t = timestamp_ms / 1000
+        return any(start <= t <= end for start, end in self.pins)
+    
+    def _is_expired(self, record, now):
+        t = record.timestamp_ms / 1000
+        if record.pinned or self._is_pinned(record.timestamp_ms):
+            return t < now - self.pinned_max_age
+        return t < now - self.max_age
+    
+    # --- Writing ---
+    
+    def submit(self, frame):
+        """
+        Queue a frame for storing.
+        
+        Returns:
+            Capture id, or None if the frame was dropped
+        """
+        if self.read_only:
+            raise ValueError("Capture store is read-only")
+        try:
+            self.queue.put_nowait(frame)
+        except queue.Full:
+            self.dropped += 1
+            logger.warning(f"Capture writer busy, dropped frame {frame.sequence}")
+            return None
+        return f"{int(frame.timestamp * 1000)}-{frame.sequence}"
+    
+    def _write_loop(self):
+        """Encode each frame once, refresh latest.jpg and append it to the ring."""
+        last_expiry = time.monotonic()
+        while True:
+            try:
+                frame = self.queue.get(timeout=60)
+            except queue.Empty:
+                frame = False
+            if frame is None:
+                break
+            
+            try:
+                if frame is not False:
+                    self._store_frame(frame)
+                if time.monotonic() - last_expiry >= 60:
+                    last_expiry = time.monotonic()
+                    self.expire()
+            except Exception as e:
+                logger.error(f"Failed to store capture: {e}")
+            finally:
+                if frame is not False:
+                    self.queue.task_done()
+    
+    def _store_frame(self, frame):
+        frame_hash = dhash(frame) if self.dedup_bits is not None else None
+        keyframe = self.keyframe
+        if (frame_hash is not None and keyframe is not None and self._valid(keyframe)
+                and hamming(frame_hash, self.keyframe_hash) < self.dedup_bits
+                and frame.timestamp - keyframe.timestamp < self.keyframe_interval):
+            self.append_duplicate(keyframe, frame.timestamp, frame.sequence)
+            return
+        
+        if frame.jpeg is not None:
+            # Camera already delivered JPEG: store it as-is
+            data = frame.jpeg
+        else:
+            ok, jpeg = cv2.imencode('.jpg', frame.image, [cv2.IMWRITE_JPEG_QUALITY, self.quality])
+            if not ok:
+                logger.error(f"Failed to encode frame {frame.sequence}")
+                return
+            data = jpeg.tobytes()
+        
+        if self.write_latest:
+            # Replace atomically so the dashboard never serves a partial file
+            tmp_path = self.directory / '.latest.jpg.tmp'
+            tmp_path.write_bytes(data)
+            os.replace(tmp_path, self.directory / 'latest.jpg')
+        
+        record = self.append(data, frame.timestamp, frame.sequence)
+        if record is not None:
+            self.keyframe, self.keyframe_hash = record, frame_hash
+    
+    def append(self, data, timestamp, sequence):
+        """
+        Store one encoded capture (called from the writer thread).
+        
+        Returns:
+            CaptureRecord, or None if the capture is larger than a segment
+        """
+        if len(data) > self.segment_bytes - SEGMENT_HEADER.size:
+            logger.error(f"Capture of {len(data)} bytes doesn't fit a segment")
+            return None
+        
+        with self.lock:
+            if self.position + len(data) > self.segment_bytes:
+                self._advance()
+            
+            record = CaptureRecord(int(timestamp * 1000), sequence, self.generations[self.segment],
+                                   self.position, len(data), self.segment)
+            os.pwrite(self.fds[self.segment], data, self.position)
+            self.position += len(data)
+            self._write_record(record)
+            self._insert(record)
+        
+        self.written += 1
+        self.bytes_written += len(data)
+        return record
+    
+    def append_duplicate(self, original, timestamp, sequence):
+        """
+        Record a capture identical to a stored one without writing its data.
+        
+        Returns:
+            CaptureRecord sharing the original's bytes
+        """
+        with self.lock:
+            record = CaptureRecord(int(timestamp * 1000), sequence, original.generation, original.offset,
+                                   original.length, original.segment, original.flags | FLAG_DUPLICATE)
+            self._write_record(record)
+            self._insert(record)
+        
+        self.duplicates += 1
+        self.bytes_saved += original.length
+        return record
+    
+    def _insert(self, record):
+        if not self.times or record.timestamp_ms >= self.times[-1]:
+            self.records.append(record)
+            self.times.append(record.timestamp_ms)
+        else:
+            # Clock stepped back: keep the index sorted
+            i = bisect.bisect_right(self.times, record.timestamp_ms)
+            self.records.insert(i, record)
+            self.times.insert(i, record.timestamp_ms)
+    
+    def _advance(self):
+        """Move to the next segment, evicting what it holds (pinned captures are moved out)."""
+        number = (self.segment + 1) % self.segment_count
+        fd = self.fds[number]
+        
+        kept = []
+        copies = {}  # (generation, offset) -> pinned record holding that data
+        for record in self.records:
+            if record.pinned or record.segment != number:
+                kept.append(record)
+            elif self._is_pinned(record.timestamp_ms):
+                kept.append(self._move_to_pinned(record, fd, copies))
+            else:
+                self.evicted += 1
+        
+        self.generations[number] += 1
+        os.pwrite(fd, SEGMENT_HEADER.pack(SEGMENT_MAGIC, SEGMENT_VERSION, number, self.generations[number]), 0)
+        
+        self.records = kept
+        self.times = [r.timestamp_ms for r in kept]
+        self.segment = number
+        self.position = SEGMENT_HEADER.size
+        
+        self._enforce_pinned_budget()
+        if self.index_records > 2 * len(self.records) + 256:
+            self._compact_index()
+    
+    def _move_to_pinned(self, record, fd, copies):
+        """Copy a capture out of a segment about to be recycled (once per stored JPEG)."""
+        copy = copies.get((record.generation, record.offset))
+        if copy is None:
+            pinned = CaptureRecord(record.timestamp_ms, record.sequence, record.sequence, 0, record.length,
+                                   PINNED_SEGMENT, record.flags | FLAG_PINNED)
+            self._pinned_path(pinned).write_bytes(os.pread(fd, record.length, record.offset))
+            self.pinned_bytes += record.length
+            copies[(record.generation, record.offset)] = pinned
+        else:
+            # Records are in time order, so the copy is never newer
+            pinned = CaptureRecord(record.timestamp_ms, record.sequence, copy.generation,
+                                   record.timestamp_ms - copy.timestamp_ms + copy.offset, record.length,
+                                   PINNED_SEGMENT, record.flags | FLAG_PINNED)
+        self._write_record(pinned)
+        return pinned
+    
+    def _delete_pinned(self, removed, kept):
+        """Delete the pinned files of removed records that no kept record shares."""
+        used = {self._pinned_path(r) for r in kept if r.pinned}
+        files = {self._pinned_path(r): r.length for r in removed if r.pinned}
+        for path, length in files.items():
+            if path not in used:
+                path.unlink(missing_ok=True)
+                self.pinned_bytes -= length
+    
+    def _enforce_pinned_budget(self):
+        """Delete the oldest pinned captures beyond the pinned size budget."""
+        if self.pinned_bytes <= self.pinned_bytes_limit:
+            return
+        # A file shared by deduplicated captures is freed with its last one
+        references = Counter(self._pinned_path(r) for r in self.records if r.pinned)
+        removed = set()
+        for record in self.records:
+            if self.pinned_bytes <= self.pinned_bytes_limit:
+                break
+            if record.pinned:
+                path = self._pinned_path(record)
+                references[path] -= 1
+                if not references[path]:
+                    path.unlink(missing_ok=True)
+                    self.pinned_bytes -= record.length
+                removed.add(id(record))
+        logger.warning(f"Pinned capture budget exceeded, deleted the {len(removed)} oldest")
+        self.records = [r for r in self.records if id(r) not in removed]
+        self.times = [r.timestamp_ms for r in self.records]
+    
+    def expire(self, now=None):
+        """Drop captures (and pins) past their maximum age."""
+        now = time.time() if now is None else now
+        with self.lock:
+            kept, removed = [], []
+            for record in self.records:
+                (removed if self._is_expired(record, now) else kept).append(record)
+            if removed:
+                self._delete_pinned(removed, kept)
+                self.expired += len(removed)
+                self.records = kept
+                self.times = [r.timestamp_ms for r in kept]
+            
+            pins = [pin for pin in self.pins if pin[1] >= now - self.pinned_max_age]
+            if len(pins) != len(self.pins):
+                self.pins = pins
+                self._save_pins()
+    
+    # --- Reading ---
+    
+    def find(self, start=None, end=None):
+        """
+        Stored captures between two times (inclusive), oldest first.
+        
+        Returns:
+            List of CaptureRecord
+        """
+        with self.lock:
+            lo = 0 if start is None else bisect.bisect_left(self.times, int(start * 1000))
+            hi = len(self.times) if end is None else bisect.bisect_right(self.times, int(end * 1000))
+            return self.records[lo:hi]
+    
+    def nearest(self, timestamp):
+        """Stored capture closest in time, or None if the store is empty."""
+        t = int(timestamp * 1000)
+        with self.lock:
+            i = bisect.bisect_left(self.times, t)
+            candidates = self.records[max(i - 1, 0):i + 1]
+            return min(candidates, key=lambda r: abs(r.timestamp_ms - t)) if candidates else None
+    
+    def get(self, capture_id):
+        """Record for a capture id, or None if it is no longer stored."""
+        timestamp_ms, _, sequence = capture_id.partition('-')
+        try:
+            timestamp_ms, sequence = int(timestamp_ms), int(sequence)
+        except ValueError:
+            return None
+        for record in self.find(timestamp_ms / 1000, timestamp_ms / 1000):
+            if record.sequence == sequence:
+                return record
+        return None
+    
+    def read(self, record):
+        """
+        JPEG bytes of a stored capture.
+        
+        Returns:
+            bytes, or None if the capture has been evicted meanwhile
+        """
+        if record.pinned:
+            try:
+                return self._pinned_path(record).read_bytes()
+            except FileNotFoundError:
+                return None
+        fd = self.fds[record.segment]
+        data = os.pread(fd, record.length, record.offset)
+        if self.read_only:
+            # Another process writes the ring: check the segment on disk
+            header = os.pread(fd, SEGMENT_HEADER.size, 0)
+            if len(header) < SEGMENT_HEADER.size or SEGMENT_HEADER.unpack(header)[3] != record.generation:
+                return None
+        elif record.generation != self.generations[record.segment]:
+            return None  # Segment recycled while reading
+        return data
+    
+    def export(self, directory, start=None, end=None):
+        """
+        Write the captures between two times to <capture id>.jpg files.
+        
+        Returns:
+            Number of captures written
+        """
+        directory = Path(directory)
+        directory.mkdir(parents=True, exist_ok=True)
+        written = 0
+        for record in self.find(start, end):
+            data = self.read(record)
+            if data is None:
+                continue  # Evicted since find()
+            (directory / f"{record.id}.jpg").write_bytes(data)
+            written += 1
+        return written
+    
+    # --- Lifecycle ---
+    
+    def flush(self):
+        """Wait until every queued frame has been stored."""
+        self.queue.join()
+    
+    def close(self):
+        """Store remaining frames, stop the writer and close the files."""
+        if self.thread.is_alive():
+            self.queue.put(None)
+            self.thread.join(timeout=5)
+        with self.lock:
+            if self.fds:
+                if not self.read_only:
+                    self.index_file.close()
+                for fd in self.fds:
+                    os.close(fd)
+                self.fds = []
+    
+    def get_stats(self):
+        """Storage metrics for the dashboard."""
+        with self.lock:
+            oldest = self.records[0].timestamp if self.records else None
+            pinned = sum(1 for r in self.records if r.pinned)
+            captures = len(self.records)
+        return {
+            'captures': captures,
+            'pinned': pinned,
+            'pins': len(self.pins),
+            'oldest': oldest,
+            'capacity_mb': self.segment_count * self.segment_bytes / 1024 / 1024,
+            'pinned_mb': self.pinned_bytes / 1024 / 1024,
+            'written': self.written,
+            'mb_written': self.bytes_written / 1024 / 1024,
+            'duplicates': self.duplicates,
+            'mb_saved': self.bytes_saved / 1024 / 1024,
+            'dropped': self.dropped,
+            'evicted': self.evicted,
+            'expired': self.expired,
+        }
+
+
+def test_capture_store():
+    """Ring eviction, time lookup, pinning, age expiry, reopening and deduplication."""
+    import shutil
+    import tempfile
+    
+    import numpy as np
+    from frame import Frame
+    
+    print("Testing capture store...")
+    
+    directory = Path(tempfile.mkdtemp())
+    try:
+        def open_store():
+            # 4 x 64 KB segments: about 24 captures of 10 KB
+            return CaptureStore(directory, capacity_mb=0.25, segment_mb=0.0625, max_age=3600,
+                                pinned_mb=0.2, pinned_max_age=7200)
+        
+        store = open_store()
+        t0 = time.time() - 200
+        store.pin(t0 + 1.9, t0 + 6.1)
+        
+        # Several captures within the same second get distinct ids
+        for i in range(60):
+            store.append(bytes([i]) * 10_000, t0 + i * 0.4, i)
+        ids = [r.id for r in store.find()]
+        ok = len(ids) == len(set(ids))
+        
+        stats = store.get_stats()
+        ok &= stats['evicted'] > 0 and stats['pinned'] == 11
+        ok &= all(store.read(r) == bytes([r.sequence]) * 10_000 for r in store.find())
+        ok &= [r.sequence for r in store.find(t0 + 1.9, t0 + 6.1)] == list(range(5, 16))
+        ok &= store.nearest(t0 + 23.5).sequence == 59
+        print(f"  {stats['captures']} captures kept of 60 ({stats['pinned']} pinned), "
+              f"{stats['evicted']} evicted, ring {stats['capacity_mb']:.2f} MB")
+        store.close()
+        
+        # Reopened: same index, writing resumes where it stopped
+        store = open_store()
+        ok &= [r.id for r in store.find()] == ids
+        store.append(b'x' * 10_000, t0 + 100, 100)
+        ok &= store.read(store.get(f"{int((t0 + 100) * 1000)}-100")) == b'x' * 10_000
+        
+        # Export next to the open writer: a read-only view of the same ring
+        reader = CaptureStore(directory, read_only=True)
+        exported = directory / 'exported'
+        count = reader.export(exported, t0 + 1.9, t0 + 6.1)
+        ok &= reader.segment_count == 4 and [r.id for r in reader.find()] == [r.id for r in store.find()]
+        first = store.find(t0 + 1.9)[0]
+        ok &= count == 11 and (exported / f"{first.id}.jpg").read_bytes() == bytes([5]) * 10_000
+        reader.close()
+        
+        # Age retention: unpinned captures go after an hour, pinned after two
+        store.expire(now=t0 + 3800)
+        ok &= all(r.pinned or store._is_pinned(r.timestamp_ms) for r in store.find())
+        store.expire(now=t0 + 7300)
+        ok &= not store.find()
+        
+        # Background writer with frames
+        frame = Frame(np.zeros((120, 160, 3), dtype=np.uint8), t0 + 200, 200)
+        capture_id = store.submit(frame)
+        store.flush()
+        ok &= store.read(store.get(capture_id))[:2] == b'\xff\xd8'
+        ok &= (directory / 'latest.jpg').exists()
+        store.close()
+        
+        # Quiet day: a static scene with sensor noise, debris arriving twice
+        shutil.rmtree(directory / 'ring')
+        store = CaptureStore(directory, capacity_mb=8, segment_mb=1)
+        y, x = np.mgrid[0:360, 0:640]
+        scene = (120 + 40 * np.sin(x / 37.0) * np.cos(y / 23.0)).astype(np.uint8)
+        for i in range(300):
+            image = np.dstack([scene] * 3) + np.random.randint(0, 4, (360, 640, 3), dtype=np.uint8)
+            if i >= 100:
+                image[100:200, 200:300] = 30
+            if i >= 220:
+                image[220:330, 380:560] = 200
+            store.submit(Frame(image, t0 + 1000 + i * 5, 1000 + i))
+            store.flush()
+        stats = store.get_stats()
+        timeline = store.find(t0 + 1000, t0 + 2500)
+        reduction = (stats['mb_written'] + stats['mb_saved']) / stats['mb_written']
+        print(f"  Quiet day: {stats['written']} of {len(timeline)} frames written, "
+              f"{reduction:.0f}x less data, {stats['duplicates']} duplicate records")
+        ok &= len(timeline) == 300 and stats['written'] == 3 and reduction >= 10
+        ok &= store.read(timeline[150]) == store.read(timeline[100])
+        ok &= store.read(timeline[250]) != store.read(timeline[150])
+        store.close()
+        
+        # Pinning a deduplicated range copies each stored JPEG once
+        shutil.rmtree(directory / 'ring')
+        store = open_store()
+        t1 = t0 + 3000
+        store.pin(t1 + 4.5, t1 + 30.5)
+        for data, first, last in ((b'a', 0, 20), (b'b', 21, 39)):
+            original = store.append(data * 10_000, t1 + first, 300 + first)
+            for i in range(first + 1, last + 1):
+                store.append_duplicate(original, t1 + i, 300 + i)
+        for i in range(30):
+            store.append(bytes([i]) * 10_000, t1 + 100 + i, 400 + i)
+        
+        def pinned_ok(sequences, files):
+            records = store.find(t1, t1 + 40)
+            return ([r.sequence for r in records] == sequences and all(r.pinned for r in records)
+                    and all(store.read(r) == (b'a' if r.sequence <= 320 else b'b') * 10_000 for r in records)
+                    and len(list(store.pinned_dir.iterdir())) == files and store.pinned_bytes == files * 10_000)
+        
+        ok &= pinned_ok(list(range(305, 331)), 2)
+        store.close()
+        store = open_store()
+        ok &= pinned_ok(list(range(305, 331)), 2)
+        # The copy stays while later duplicates still use it, then goes with the last
+        store.expire(now=t1 + 7200 + 14.5)
+        ok &= pinned_ok(list(range(315, 331)), 2)
+        store.expire(now=t1 + 7200 + 21.5)
+        ok &= pinned_ok(list(range(322, 331)), 1)
+        print(f"  Pinned deduplicated range: {len(store.find(t1, t1 + 40))} captures in "
+              f"{store.pinned_bytes // 10_000} pinned file(s)")
+        store.close()
+    finally:
+        shutil.rmtree(directory)
+    
+    print("Capture store test PASSED" if ok else "Capture store test FAILED")
+
+
+def parse_time(text):
+    """Unix timestamp or ISO 8601 date/time (local time) to a timestamp."""
+    try:
+        return float(text)
+    except ValueError:
+        return datetime.fromisoformat(text).timestamp()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='DrainSentinel capture store')
+    subparsers = parser.add_subparsers(dest='command')
+    export = subparsers.add_parser('export', help='Write stored captures in a time range to JPEG files')
+    export.add_argument('output', help='Directory for the <capture id>.jpg files')
+    export.add_argument('--start', type=parse_time, help='Unix timestamp or ISO date/time (default: oldest)')
+    export.add_argument('--end', type=parse_time, help='Unix timestamp or ISO date/time (default: newest)')
+    export.add_argument('--captures', default='data/captures', help='Camera capture directory')
+    args = parser.parse_args()
+    
+    logging.basicConfig(level=logging.INFO)
+    if args.command == 'export':
+        store = CaptureStore(args.captures, read_only=True)
+        count = store.export(args.output, args.start, args.end)
+        store.close()
+        print(f"Exported {count} captures to {args.output}")
+    else:
+        logging.getLogger().setLevel(logging.DEBUG)
+        test_capture_store()
@@ -0,0 +1,353 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Two-Stage Detector Cascade
+
+Most frames show a clear drain. The cascade screens every frame with the
+cheap SimpleBlockageDetector statistics (a few ms on a reduced decode)
+and only runs the full model when the screen can't rule a blockage out.
+Frames scoring below the calibrated threshold are reported clear
+directly.
+
+The threshold must be calibrated on labelled images from the actual
+camera, so that (nearly) every blocked image scores above it:
+
+    python3 cascade.py calibrate data/labelled --recall 1.0 --save
+
+expects data/labelled/clear/, data/labelled/partial_blockage/ and
+data/labelled/full_blockage/, and stores the result under 'cascade' in
+config/calibration.json. Without a calibration the cascade is not used.
+"""
+
+import argparse
+import json
+import logging
+import threading
+import time
+from pathlib import Path
+
+import numpy as np
+
+from ai_detector import SimpleBlockageDetector
+from frame import Frame
+from jpeg_decode import decode_jpeg, jpeg_size
+
+logger = logging.getLogger('DrainSentinel.Cascade')
+
+LABELS = ['clear', 'partial_blockage', 'full_blockage']
+IMAGE_SUFFIXES = ('.jpg', '.jpeg', '.png')
+
+
+class DetectorCascade:
+    """Cheap screen in front of a BlockageDetector; same detect/prepare/infer interface."""
+    
+    def __init__(self, detector, threshold, screen=None):
+        """
+        Initialize the cascade.
+        
+        Args:
+            detector: Full BlockageDetector
+            threshold: Screen score below which a frame is reported clear
+            screen: SimpleBlockageDetector (created if None)
+        """
+        self.detector = detector
+        self.threshold = threshold
+        self.screen = screen or SimpleBlockageDetector()
+        
+        # Every camera's preprocess thread shares the cascade
+        self.lock = threading.Lock()
+        self.frames = 0
+        self.screened = 0
+        self.screen_time = 0.0
+        self.full_time = 0.0
+    
+    def screen_score(self, image_input, rois=None):
+        """
+        First-stage blockage score of an image.
+        
+        Args:
+            image_input: File path, Frame or BGR array
+            rois: Optional regions; the highest-scoring region counts
+        
+        Returns:
+            Score (0-1), or None if the image couldn't be loaded
+        """
+        size = self.screen.ANALYSIS_SIZE
+        if isinstance(image_input, Frame):
+            image, full_width = image_input.image_for(size), image_input.shape[1]
+        elif isinstance(image_input, (str, Path)):
+            try:
+                data = Path(image_input).read_bytes()
+            except OSError as e:
+                logger.error(f"Failed to read image {image_input}: {e}")
+                return None
+            image = decode_jpeg(data, size)
+            full_width = (jpeg_size(data) or (image.shape[1] if image is not None else 0, 0))[0]
+        else:
+            image, full_width = image_input, image_input.shape[1]
+        if image is None:
+            return None
+        
+        # JPEGs and MJPEG frames arrive as a reduced decode: tell analyze how
+        # reduced, so they score like the same scene at full resolution
+        scale = full_width / image.shape[1]
+        if not rois:
+            return self.screen.score(*self.screen.analyze(image, scale))
+        return max(self.screen.score(*self.screen.analyze(roi.crop(image), scale)) for roi in rois)
+    
+    def prepare(self, image_input, rois=None):
+        """
+        Screen the image, then preprocess it for the full model if needed.
+        
+        Returns:
+            A finished 'clear' result dictionary if the screen ruled out a
+            blockage, otherwise what BlockageDetector.prepare returns
+        """
+        start = time.perf_counter()
+        score = self.screen_score(image_input, rois)
+        screened = score is not None and score < self.threshold
+        with self.lock:
+            self.screen_time += time.perf_counter() - start
+            self.frames += 1
+            self.screened += screened
+        
+        if screened:
+            return {
+                'blocked': False,
+                'confidence': 1 - score,
+                'class_name': 'clear',
+                'all_scores': {'screen_score': score},
+                'screened': True,
+            }
+        
+        start = time.perf_counter()
+        prepared = self.detector.prepare(image_input, rois)
+        with self.lock:
+            self.full_time += time.perf_counter() - start
+        return prepared
+    
+    def infer(self, prepared, rois=None):
+        """Pass screened results through; run the full model on the rest."""
+        if isinstance(prepared, dict):
+            return prepared
+        
+        start = time.perf_counter()
+        result = self.detector.infer(prepared, rois)
+        with self.lock:
+            self.full_time += time.perf_counter() - start
+        return result
+    
+    def infer_batch(self, items):
+        """infer() for several (prepared, rois) pairs, with one model call for the escalated ones."""
+        results = [prepared if isinstance(prepared, dict) else None for prepared, _ in items]
+        escalated = [i for i, result in enumerate(results) if result is None]
+        if escalated:
+            start = time.perf_counter()
+            for i, result in zip(escalated, self.detector.infer_batch([items[i] for i in escalated])):
+                results[i] = result
+            with self.lock:
+                self.full_time += time.perf_counter() - start
+        return results
+    
+    def detect(self, image_input, rois=None):
+        """Screen, and run the full model only if the screen is unsure."""
+        return self.infer(self.prepare(image_input, rois), rois)
+    
+    def close(self):
+        self.detector.close()
+    
+    def get_stats(self):
+        """Screen hit rate and latency."""
+        with self.lock:
+            frames, screened = self.frames, self.screened
+            screen_time, full_time = self.screen_time, self.full_time
+        escalated = frames - screened
+        return {
+            'threshold': self.threshold,
+            'frames': frames,
+            'screened': screened,
+            'hit_rate': screened / frames if frames else 0.0,
+            'screen_ms': screen_time / frames * 1000 if frames else None,
+            'full_model_ms': full_time / escalated * 1000 if escalated else None,
+            'mean_latency_ms': (screen_time + full_time) / frames * 1000 if frames else None,
+        }
+
+
+def labelled_images(directory):
+    """(path, label) for every image under directory/<label>/."""
+    directory = Path(directory)
+    images = []
+    for label in LABELS:
+        for path in sorted((directory / label).glob('*')):
+            if path.suffix.lower() in IMAGE_SUFFIXES:
+                images.append((path, label))
+    return images
+
+
+def calibrate(directory, target_recall=1.0, margin=0.02, rois=None, screen=None):
+    """
+    Pick the screen threshold from labelled images.
+    
+    The threshold sits just below the blocked images' scores, allowing
+    (1 - target_recall) of them to be screened out, and lowered by margin
+    for images that score a little lower than anything in the set.
+    
+    Args:
+        directory: Directory with clear/, partial_blockage/, full_blockage/
+        target_recall: Fraction of blocked images that must reach the full model
+        margin: Safety margin subtracted from the threshold
+        rois: The detection regions used at runtime (screened the same way)
+    
+    Returns:
+        Calibration dictionary (threshold, achieved recall, clear hit rate,
+        image counts)
+    """
+    cascade = DetectorCascade(None, 0.0, screen)
+    scores = {label: [] for label in LABELS}
+    for path, label in labelled_images(directory):
+        score = cascade.screen_score(path, rois)
+        if score is None:
+            logger.warning(f"Skipping unreadable image {path}")
+            continue
+        scores[label].append(score)
+    
+    blocked = np.sort(np.array(scores['partial_blockage'] + scores['full_blockage']))
+    clear = np.array(scores['clear'])
+    if len(blocked) == 0 or len(clear) == 0:
+        raise ValueError(f"Need clear and blocked images under {directory}")
+    
+    allowed_misses = int(np.floor((1 - target_recall) * len(blocked)))
+    threshold = float(blocked[allowed_misses]) - margin
+    
+    return {
+        'threshold': round(threshold, 4),
+        'target_recall': target_recall,
+        'recall': float(np.mean(blocked >= threshold)),
+        'clear_hit_rate': float(np.mean(clear < threshold)),
+        'images': {label: len(values) for label, values in scores.items()},
+    }
+
+
+def save_calibration(result):
+    """Store the cascade calibration in config/calibration.json."""
+    from calibrate import load_calibration
+    
+    calibration = load_calibration() or {}
+    calibration['cascade'] = result
+    config_file = Path('config/calibration.json')
+    config_file.parent.mkdir(exist_ok=True)
+    with open(config_file, 'w') as f:
+        json.dump(calibration, f, indent=2)
+    print(f"Cascade calibration saved to: {config_file}")
+
+
+def test_cascade():
+    """Calibrate on a synthetic labelled set, then run a mostly-clear stream."""
+    import shutil
+    import tempfile
+    
+    import cv2
+    from ai_detector import BlockageDetector
+    
+    print("Testing detector cascade...")
+    
+    np.random.seed(0)
+    y, x = np.mgrid[0:720, 0:1280]
+    
+    def scene(label, i):
+        # Wet grey street at varying light, with debris for blocked labels
+        light = 150 + 10 * np.sin(i)
+        base = light + 8 * np.sin(x / 53.0 + i) * np.cos(y / 41.0)
+        img = np.dstack([base, base * 0.97, base * 0.93]) + np.random.normal(0, 3, (720, 1280, 3))
+        if label != 'clear':
+            count = 40 if label == 'partial_blockage' else 200
+            for _ in range(count):
+                colour = tuple(int(c) for c in np.random.randint(0, 120, 3))
+                center = (int(np.random.randint(300, 980)), int(np.random.randint(200, 620)))
+                axes = (int(np.random.randint(8, 40)), int(np.random.randint(4, 20)))
+                cv2.ellipse(img, center, axes, int(np.random.randint(0, 180)), 0, 360, colour, -1)
+        return np.clip(img, 0, 255).astype(np.uint8)
+    
+    directory = Path(tempfile.mkdtemp())
+    try:
+        images = []
+        for label in LABELS:
+            (directory / label).mkdir()
+            for i in range(12):
+                images.append((directory / label / f"{i:02d}.jpg", scene(label, i)))
+                cv2.imwrite(str(images[-1][0]), images[-1][1])
+        calibration = calibrate(directory, target_recall=1.0)
+        
+        # Calibrated on JPEG files, applied to full-size frames (OpenCV/YUYV
+        # cameras): the same scene must score the same either way
+        screen = DetectorCascade(None, calibration['threshold'])
+        differences = [abs(screen.screen_score(path) - screen.screen_score(Frame(image)))
+                       for path, image in images]
+    finally:
+        shutil.rmtree(directory)
+    print(f"  Calibration: {calibration}")
+    print(f"  JPEG file vs full-size frame screen scores differ by at most {max(differences):.4f}")
+    
+    # Stream: 90% clear frames, 10% blocked
+    cascade = DetectorCascade(BlockageDetector(), calibration['threshold'])
+    missed = 0
+    for i in range(60):
+        label = 'full_blockage' if i % 10 == 0 else 'clear'
+        result = cascade.detect(Frame(scene(label, 100 + i)))
+        missed += label != 'clear' and result.get('screened', False)
+    stats = cascade.get_stats()
+    print(f"  Stream: hit rate {stats['hit_rate']:.0%}, screen {stats['screen_ms']:.2f} ms, "
+          f"full model {stats['full_model_ms']:.2f} ms, mean {stats['mean_latency_ms']:.2f} ms per frame, "
+          f"blocked frames screened out: {missed}")
+    
+    ok = calibration['recall'] == 1.0 and calibration['clear_hit_rate'] > 0.5
+    ok &= max(differences) < 0.01
+    ok &= missed == 0 and stats['hit_rate'] > 0.5
+    
+    # Four cameras preparing concurrently on one shared cascade (threshold 0
+    # escalates everything) get exactly the tensors a lone camera would
+    import threading
+    from roi import RegionOfInterest
+    shared = DetectorCascade(BlockageDetector(cache=False), 0.0)
+    cameras = [(scene('partial_blockage', 200 + i), rois) for i, rois in enumerate(
+        [None, None, [RegionOfInterest('inlet', [[0.2, 0.3], [0.7, 0.9]])],
+         [RegionOfInterest('grate', [[0.3, 0.2], [0.8, 0.4], [0.5, 0.9]], kind='polygon')]])]
+    expected = [BlockageDetector(cache=False).prepare(Frame(image), rois) for image, rois in cameras]
+    mismatches = []
+    
+    def camera(i, frames=20):
+        image, rois = cameras[i]
+        for _ in range(frames):
+            mismatches.append(not np.array_equal(shared.prepare(Frame(image), rois), expected[i]))
+    
+    threads = [threading.Thread(target=camera, args=(i,)) for i in range(len(cameras))]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    shared_stats = shared.get_stats()
+    print(f"  {len(cameras)} cameras on one cascade: {sum(mismatches)} of {len(mismatches)} tensors differ, "
+          f"{shared_stats['frames']} frames counted")
+    ok &= not any(mismatches) and shared_stats['frames'] == len(mismatches) == 80
+    print("Cascade test PASSED" if ok else "Cascade test FAILED")
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='DrainSentinel detector cascade')
+    subparsers = parser.add_subparsers(dest='command')
+    cal = subparsers.add_parser('calibrate', help='Calibrate the screen threshold on labelled images')
+    cal.add_argument('directory', help='Directory with clear/, partial_blockage/, full_blockage/')
+    cal.add_argument('--recall', type=float, default=1.0, help='Fraction of blocked images to keep')
+    cal.add_argument('--margin', type=float, default=0.02, help='Threshold safety margin')
+    cal.add_argument('--save', action='store_true', help='Store in config/calibration.json')
+    args = parser.parse_args()
+    
+    logging.basicConfig(level=logging.INFO)
+    if args.command == 'calibrate':
+        from calibrate import load_calibration
+        from roi import load_rois
+        result = calibrate(args.directory, args.recall, args.margin, rois=load_rois(load_calibration()))
+        print(json.dumps(result, indent=2))
+        if args.save:
+            save_calibration(result)
+    else:
+        test_cascade()
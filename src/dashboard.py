@@ -9,10 +9,13 @@ Uses Flask for the backend and Socket.IO for live updates.
 import json
 import logging
 import os
+import time
 from datetime import datetime
 from pathlib import Path
 
-from flask import Flask, render_template, jsonify, Response, send_from_directory
+from flask import Flask, render_template, jsonify, request, Response, send_from_directory, url_for
+
+from streaming import DEFAULT_TIER, STREAM_TIERS
 
 logger = logging.getLogger('DrainSentinel.Dashboard')
 
@@ -78,10 +81,45 @@ def api_alerts():
 
 @app.route('/api/history')
 def api_history():
-    """Get water level history."""
+    """
+    Get water level history.
+    
+    Without parameters, returns the last 100 raw points. With any of
+    start/end/window, returns a downsampled range from the history store:
+        series: Series name (default 'water_level_cm')
+        start, end: Unix timestamps (end defaults to now)
+        window: Seconds before end, used when start is omitted
+        points: Approximate number of points wanted (default 500)
+        resolution: Seconds between points (overrides points)
+    """
     if sentinel is None:
         return jsonify([])
     
+    args = request.args
+    if any(k in args for k in ('start', 'end', 'window')):
+        try:
+            end = args.get('end', type=float) or time.time()
+            start = args.get('start', type=float)
+            if start is None:
+                start = end - args.get('window', 3600, type=float)
+            resolution = args.get('resolution', type=float)
+            if resolution is None:
+                resolution = (end - start) / max(1, args.get('points', 500, type=int))
+            
+            result = sentinel.history.query(
+                args.get('series', 'water_level_cm'), start, end, resolution)
+        except Exception as e:
+            logger.error(f"History query failed: {e}")
+            return jsonify({'error': str(e)}), 400
+        
+        history = [
+            {'timestamp': t, 'level': mean, 'min': lo, 'max': hi, 'last': last}
+            for t, mean, lo, hi, last in zip(
+                result['timestamp'].tolist(), result['mean'].tolist(),
+                result['min'].tolist(), result['max'].tolist(), result['last'].tolist())
+        ]
+        return jsonify(history)
+    
     # Convert history to list of dicts for JSON
     history = [
         {'timestamp': t, 'level': l}
@@ -107,25 +145,80 @@ def api_latest_image():
     return '', 204
 
 
+def _capture_store(camera):
+    """Capture store of the named camera (default: the first), or None."""
+    if sentinel is None or not sentinel.channels:
+        return None
+    if camera is None:
+        return sentinel.channels[0].camera.store
+    for channel in sentinel.channels:
+        if channel.name == camera:
+            return channel.camera.store
+    return None
+
+
+@app.route('/api/captures')
+def api_captures():
+    """
+    List stored captures, newest last.
+    
+    Query parameters:
+        camera: Camera name (default: the first camera)
+        start, end: Unix timestamps (end defaults to now)
+        window: Seconds before end, used when start is omitted (default 3600)
+        limit: Most recent captures returned (default 500)
+    """
+    store = _capture_store(request.args.get('camera'))
+    if store is None:
+        return jsonify([])
+    
+    args = request.args
+    end = args.get('end', type=float) or time.time()
+    start = args.get('start', type=float)
+    if start is None:
+        start = end - args.get('window', 3600, type=float)
+    records = store.find(start, end)[-args.get('limit', 500, type=int):]
+    return jsonify([
+        {'id': r.id, 'timestamp': r.timestamp, 'bytes': r.length, 'pinned': r.pinned,
+         'duplicate': r.duplicate, 'url': url_for('api_capture_image', capture_id=r.id, camera=args.get('camera'))}
+        for r in records
+    ])
+
+
+@app.route('/api/captures/<capture_id>')
+def api_capture_image(capture_id):
+    """A stored capture's JPEG by id (camera as for /api/captures)."""
+    store = _capture_store(request.args.get('camera'))
+    record = store.get(capture_id) if store is not None else None
+    data = store.read(record) if record is not None else None
+    if data is None:
+        return jsonify({'error': f"capture {capture_id} not stored"}), 404
+    return Response(data, mimetype='image/jpeg')
+
+
 @app.route('/video_feed')
 def video_feed():
-    """Stream video from camera (Motion JPEG)."""
-    if sentinel is None or sentinel.camera is None:
+    """Stream video from camera (Motion JPEG).
+    
+    Query parameters:
+        quality: Stream tier, 'low', 'medium' (default) or 'high'
+        camera: Camera name (default: the first camera)
+    """
+    if sentinel is None or sentinel.camera is None or sentinel.streamer is None:
         return '', 204
     
-    def generate():
-        while True:
-            frame = sentinel.camera.get_stream_frame()
-            if frame is not None:
-                yield (b'--frame\r\n'
-                       b'Content-Type: image/jpeg\r\n\r\n' + frame + b'\r\n')
-            else:
-                # Small delay if no frame
-                import time
-                time.sleep(0.1)
+    # Every client of a tier is sent the same pre-encoded chunks
+    quality = request.args.get('quality', DEFAULT_TIER)
+    if quality not in STREAM_TIERS:
+        return jsonify({'error': f"quality must be one of {sorted(STREAM_TIERS)}"}), 400
+    
+    camera = request.args.get('camera')
+    streamer = sentinel.streamer if camera is None else sentinel.streamers.get(camera)
+    if streamer is None:
+        return jsonify({'error': f"camera must be one of {sorted(sentinel.streamers)}"}), 404
     
     return Response(
-        generate(),
+        streamer.stream(quality),
         mimetype='multipart/x-mixed-replace; boundary=frame'
     )
 
@@ -0,0 +1,351 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Time-to-Overflow Forecasting
+
+Fits three short-horizon inflow models to the recent water level window
+of each sensor and predicts how many minutes remain until the critical
+level is reached:
+
+    linear       y = a + b t
+    quadratic    y = a + b t + c t^2      (accelerating inflow)
+    exponential  y = exp(a + b t)         (runaway inflow)
+
+The least-squares normal equations are kept as running sums, so a new
+sample costs O(1). Forecasting evaluates every model of every sensor at
+every horizon in one matrix product and returns a weighted time-to-
+critical with a 95% band. The band is each model's least-squares
+prediction interval, sigma^2 (1 + x'(X'X)^-1 x), so it includes the
+uncertainty of the fitted coefficients as well as the residual noise and
+widens the further ahead it extrapolates. (It assumes one of the model
+shapes is right; the models disagreeing widens it further, since the band
+spans every model that carries weight.)
+"""
+
+import logging
+import math
+from collections import deque
+
+import numpy as np
+
+logger = logging.getLogger('DrainSentinel.Forecast')
+
+MODELS = ['linear', 'quadratic', 'exponential']
+
+
+class WindowFit:
+    """Sliding-window least-squares sums for one sensor."""
+    
+    # Power sums of t (t^0..t^4), moments of y and of ln(y)
+    KEYS = ('s0', 's1', 's2', 's3', 's4', 'y0', 'y1', 'y2', 'yy', 'l0', 'l1', 'll')
+    
+    def __init__(self, window=600, floor=0.1):
+        """
+        Initialize the window.
+        
+        Args:
+            window: Seconds of history the models are fitted to
+            floor: Lower clamp before taking ln(y) for the exponential model
+        """
+        self.window = window
+        self.floor = floor
+        self.samples = deque()
+        self.origin = None  # Time origin (s); t is stored in minutes since origin
+        self.sums = dict.fromkeys(self.KEYS, 0.0)
+    
+    def _terms(self, t, y):
+        """Contribution of one sample to every running sum."""
+        t2 = t * t
+        l = math.log(max(y, self.floor))
+        return (1.0, t, t2, t2 * t, t2 * t2, y, t * y, t2 * y, y * y, l, t * l, l * l)
+    
+    def _rebase(self, origin):
+        """Move the time origin and recompute sums (keeps t small for precision)."""
+        self.origin = origin
+        self.sums = dict.fromkeys(self.KEYS, 0.0)
+        rebased = deque()
+        for ts, _, y in self.samples:
+            t = (ts - origin) / 60.0
+            rebased.append((ts, t, y))
+            for k, v in zip(self.KEYS, self._terms(t, y)):
+                self.sums[k] += v
+        self.samples = rebased
+    
+    def add(self, timestamp, level):
+        """Add one sample and evict samples older than the window (amortized O(1))."""
+        if self.origin is None:
+            self.origin = timestamp
+        
+        t = (timestamp - self.origin) / 60.0
+        self.samples.append((timestamp, t, level))
+        sums = self.sums
+        for k, v in zip(self.KEYS, self._terms(t, level)):
+            sums[k] += v
+        
+        while self.samples and timestamp - self.samples[0][0] > self.window:
+            _, old_t, old_y = self.samples.popleft()
+            for k, v in zip(self.KEYS, self._terms(old_t, old_y)):
+                sums[k] -= v
+        
+        if t * 60.0 > 2 * self.window:
+            self._rebase(self.samples[0][0])
+    
+    @property
+    def count(self):
+        return len(self.samples)
+    
+    @property
+    def span(self):
+        """Seconds covered by the window."""
+        if len(self.samples) < 2:
+            return 0.0
+        return self.samples[-1][0] - self.samples[0][0]
+    
+    def fit(self):
+        """
+        Solve all three models from the running sums.
+        
+        Returns:
+            (coefficients (3, 3), residual std in level units (3,),
+             current time in minutes since origin, (X'X)^-1 per model
+             (3, 3, 3), residual std the bands use (3,): level units, log
+             units for the exponential model), or None if the normal
+             equations are singular
+        """
+        s = self.sums
+        n = s['s0']
+        if n < 4:
+            return None
+        
+        # Closed-form (Cramer's rule) solves: numpy.linalg costs more than
+        # the arithmetic for 2x2 and 3x3 systems
+        s1, s2, s3, s4 = s['s1'], s['s2'], s['s3'], s['s4']
+        det2 = n * s2 - s1 * s1
+        det3 = (n * (s2 * s4 - s3 * s3) - s1 * (s1 * s4 - s2 * s3)
+                + s2 * (s1 * s3 - s2 * s2))
+        if abs(det2) < 1e-12 or abs(det3) < 1e-12:
+            return None
+        
+        y0, y1, y2 = s['y0'], s['y1'], s['y2']
+        lin = ((s2 * y0 - s1 * y1) / det2, (n * y1 - s1 * y0) / det2)
+        quad = (
+            (y0 * (s2 * s4 - s3 * s3) - s1 * (y1 * s4 - s3 * y2) + s2 * (y1 * s3 - s2 * y2)) / det3,
+            (n * (y1 * s4 - s3 * y2) - y0 * (s1 * s4 - s2 * s3) + s2 * (s1 * y2 - y1 * s2)) / det3,
+            (n * (s2 * y2 - y1 * s3) - s1 * (s1 * y2 - y1 * s2) + y0 * (s1 * s3 - s2 * s2)) / det3,
+        )
+        l0, l1 = s['l0'], s['l1']
+        exp_ = ((s2 * l0 - s1 * l1) / det2, (n * l1 - s1 * l0) / det2)
+        
+        # SSE = y'y - beta' X'y (clamped: cancellation can make it slightly negative)
+        sse_lin = max(0.0, s['yy'] - lin[0] * y0 - lin[1] * y1)
+        sse_quad = max(0.0, s['yy'] - quad[0] * y0 - quad[1] * y1 - quad[2] * y2)
+        sse_log = max(0.0, s['ll'] - exp_[0] * l0 - exp_[1] * l1)
+        
+        coeffs = (
+            (lin[0], lin[1], 0.0),
+            quad,
+            (exp_[0], exp_[1], 0.0),
+        )
+        sigma = (
+            math.sqrt(sse_lin / max(1.0, n - 2)),
+            math.sqrt(sse_quad / max(1.0, n - 3)),
+            # Log-space residual scaled to level units at the current level
+            math.sqrt(sse_log / max(1.0, n - 2)) * max(self.samples[-1][2], self.floor),
+        )
+        
+        # (X'X)^-1 from the adjugate; the 2-parameter models use the top-left 2x2
+        inv2 = ((s2 / det2, -s1 / det2, 0.0), (-s1 / det2, n / det2, 0.0), (0.0, 0.0, 0.0))
+        c01, c02, c12 = s2 * s3 - s1 * s4, s1 * s3 - s2 * s2, s1 * s2 - n * s3
+        inv3 = ((s2 * s4 - s3 * s3, c01, c02), (c01, n * s4 - s2 * s2, c12), (c02, c12, det2))
+        inverses = np.array((inv2, inv3, inv2))
+        inverses[1] /= det3
+        band_sigma = (sigma[0], sigma[1], math.sqrt(sse_log / max(1.0, n - 2)))
+        
+        return coeffs, sigma, self.samples[-1][1], inverses, band_sigma
+
+
+class OverflowForecaster:
+    """Time-to-critical forecaster for one or more level sensors."""
+    
+    def __init__(self, critical_level=80, window=600, max_horizon=120, step=0.5,
+                 min_points=30, min_span=120):
+        """
+        Initialize the forecaster.
+        
+        Args:
+            critical_level: Level (same units as samples, e.g. %) that counts as critical
+            window: Seconds of history the models are fitted to
+            max_horizon: Furthest forecast horizon in minutes
+            step: Horizon resolution in minutes
+            min_points: Samples needed before forecasting
+            min_span: Seconds of history needed before forecasting
+        """
+        self.critical_level = critical_level
+        self.window = window
+        self.min_points = min_points
+        self.min_span = min_span
+        self.fits = {}
+        
+        # Horizon powers [1, h, h^2] for the polynomial models, shape (3, H)
+        self.horizons = np.arange(0.0, max_horizon + step, step)
+        self.powers = np.vstack((np.ones_like(self.horizons), self.horizons, self.horizons ** 2))
+    
+    def update(self, timestamp, level, sensor='level'):
+        """
+        Add one sample for a sensor (O(1)).
+        
+        Args:
+            timestamp: Unix time in seconds
+            level: Water level (same units as critical_level)
+            sensor: Sensor name
+        """
+        fit = self.fits.get(sensor)
+        if fit is None:
+            fit = self.fits[sensor] = WindowFit(self.window)
+        fit.add(timestamp, level)
+    
+    def forecast(self):
+        """
+        Forecast time-to-critical for every sensor.
+        
+        Returns:
+            Dictionary of sensor -> forecast dictionary (see _summarize), with
+            None for sensors that don't have enough history yet
+        """
+        ready = []
+        results = {}
+        for sensor, fit in self.fits.items():
+            solved = fit.fit() if fit.count >= self.min_points and fit.span >= self.min_span else None
+            if solved is None:
+                results[sensor] = None
+            else:
+                ready.append((sensor, fit, solved))
+        
+        if not ready:
+            return results
+        
+        # Re-express each model around "now" so horizons start at 0:
+        # substitute t = t_now + h into a + b t + c t^2
+        coeffs = np.empty((len(ready), 3, 3))
+        sigmas = np.empty((len(ready), 3))
+        band_sigmas = np.empty((len(ready), 3))
+        inverses = np.empty((len(ready), 3, 3, 3))
+        t_nows = np.empty(len(ready))
+        for i, (_, _, (c, sigma, t_now, inverse, band_sigma)) in enumerate(ready):
+            for m, (a, b, q) in enumerate(c):
+                coeffs[i, m] = (a + b * t_now + q * t_now * t_now, b + 2 * q * t_now, q)
+            sigmas[i] = sigma
+            band_sigmas[i] = band_sigma
+            inverses[i] = inverse
+            t_nows[i] = t_now
+        
+        # (S, 3 models, H horizons); the exponential model is linear in log space
+        curves = coeffs @ self.powers
+        
+        # Prediction interval half-width: 2 sigma sqrt(1 + x'(X'X)^-1 x), x = [1, t, t^2]
+        # in the fit's own time base (t = t_now + h)
+        t = t_nows[:, None] + self.horizons[None, :]
+        x = np.stack((np.ones_like(t), t, t * t), axis=1)                  # (S, 3, H)
+        leverage = np.einsum('sih,smij,sjh->smh', x, inverses, x)
+        half = 2.0 * band_sigmas[:, :, None] * np.sqrt(1.0 + np.maximum(leverage, 0.0))
+        
+        # Central, early (upper) and late (lower) curves: (S, 3, 3 bands, H)
+        bands = curves[:, :, None, :] + np.array([0.0, 1.0, -1.0])[None, None, :, None] \
+            * half[:, :, None, :]
+        with np.errstate(over='ignore'):
+            curves[:, 2] = np.exp(curves[:, 2])
+            bands[:, 2] = np.exp(bands[:, 2])
+        crossed = bands >= self.critical_level
+        any_crossed = crossed.any(axis=-1)
+        first = np.argmax(crossed, axis=-1)
+        eta = np.where(any_crossed, self.horizons[first], np.inf)
+        
+        for i, (sensor, fit, _) in enumerate(ready):
+            results[sensor] = self._summarize(eta[i], sigmas[i], curves[i], fit)
+        
+        return results
+    
+    def _summarize(self, eta, sigma, curves, fit):
+        """
+        Combine per-model ETAs into one forecast.
+        
+        Models are weighted by inverse residual variance, so whichever shape
+        fits the recent window best dominates.
+        """
+        weights = 1.0 / np.maximum(sigma, 1e-3) ** 2
+        weights /= weights.sum()
+        
+        central = eta[:, 0]
+        finite = np.isfinite(central)
+        # Weighted mean over models that cross; if most weight says "no crossing", report none
+        if weights[finite].sum() >= 0.5:
+            minutes = float((central[finite] * weights[finite]).sum() / weights[finite].sum())
+        else:
+            minutes = None
+        
+        early = eta[:, 1][weights > 0.1]
+        late = eta[:, 2][weights > 0.1]
+        low = float(early.min()) if len(early) and np.isfinite(early.min()) else None
+        high = float(late.max()) if len(late) and np.isfinite(late.max()) else None
+        
+        return {
+            'minutes_to_critical': minutes,
+            'minutes_to_critical_low': low,
+            'minutes_to_critical_high': high,
+            'best_model': MODELS[int(np.argmax(weights))],
+            'models': {
+                name: {
+                    'minutes_to_critical': float(central[m]) if np.isfinite(central[m]) else None,
+                    'weight': float(weights[m]),
+                    'residual_std': float(sigma[m]),
+                    'level_in_30_min': float(curves[m][np.searchsorted(self.horizons, 30.0)])
+                    if self.horizons[-1] >= 30 else None,
+                }
+                for m, name in enumerate(MODELS)
+            },
+            'window_points': fit.count,
+        }
+
+
+def test_forecast():
+    """Forecast a simulated accelerating rise and time the update path."""
+    import random
+    import time
+    
+    print("Testing overflow forecaster...")
+    
+    random.seed(1)
+    forecaster = OverflowForecaster(critical_level=80)
+    
+    # Level rising from 40% with slowly accelerating inflow, 1 Hz, 0.5% noise
+    t0 = 1_700_000_000.0
+    update_times = []
+    for i in range(1200):
+        t = t0 + i
+        level = 40 + 0.5 * (i / 60) + 0.02 * (i / 60) ** 2 + random.gauss(0, 0.5)
+        start = time.perf_counter()
+        forecaster.update(t, level)
+        update_times.append(time.perf_counter() - start)
+    
+    start = time.perf_counter()
+    for _ in range(100):
+        result = forecaster.forecast()['level']
+    forecast_time = (time.perf_counter() - start) / 100
+    
+    # True crossing: solve 40 + 0.5 m + 0.02 m^2 = 80 for minutes m, minus 20 min elapsed
+    m = (-0.5 + math.sqrt(0.25 + 4 * 0.02 * 40)) / (2 * 0.02)
+    true_eta = m - 20
+    
+    print(f"  Update: {np.median(update_times) * 1e6:.1f} us, forecast: {forecast_time * 1e6:.0f} us")
+    print(f"  Predicted: {result['minutes_to_critical']:.1f} min "
+          f"[{result['minutes_to_critical_low']}, {result['minutes_to_critical_high']}] "
+          f"(true {true_eta:.1f}, best model {result['best_model']})")
+    
+    low, high = result['minutes_to_critical_low'], result['minutes_to_critical_high']
+    ok = result['minutes_to_critical'] is not None and abs(result['minutes_to_critical'] - true_eta) < 5
+    ok &= low is not None and high is not None and low <= true_eta <= high
+    print("Forecast test PASSED" if ok else "Forecast test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    test_forecast()
@@ -0,0 +1,206 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Shared Camera Frames
+
+A Frame wraps one captured image so it can be handed from the camera to
+detection, streaming and storage without copying or touching the disk.
+Python reference counting keeps the pixels alive for as long as any
+consumer holds the frame; the array is made read-only so no consumer can
+modify what the others see.
+
+Saving captures is an optional side effect rather than a step of the
+inference cycle: CaptureStore (capture_store.py) persists frames on a
+background thread.
+
+FrameBroadcaster owns the only thread that reads the camera. It
+publishes each frame into a small ring, and detection, streaming and
+recording all read the latest frame from there.
+"""
+
+import logging
+import threading
+import time
+
+import cv2
+import numpy as np
+
+from jpeg_decode import SCALE_FLAGS, jpeg_scale, jpeg_size
+
+logger = logging.getLogger('DrainSentinel.Frame')
+
+
+class Frame:
+    """An immutable captured image plus capture metadata."""
+    
+    __slots__ = ('_image', 'jpeg', '_reduced', 'timestamp', 'sequence', 'camera_id', '__weakref__')
+    
+    def __init__(self, image=None, timestamp=None, sequence=0, camera_id=0, jpeg=None):
+        """
+        Wrap a captured image.
+        
+        Args:
+            image: BGR numpy array (marked read-only, not copied)
+            timestamp: Capture time (Unix seconds), defaults to now
+            sequence: Frame counter from the capture source
+            camera_id: Which camera produced the frame
+            jpeg: Encoded frame as delivered by an MJPEG camera. Without an
+                image, pixels are only decoded when first needed, and at
+                reduced scale when a consumer only needs a small image.
+        """
+        if image is None and jpeg is None:
+            raise ValueError("Frame needs an image or JPEG data")
+        if image is not None:
+            image.flags.writeable = False
+        self._image = image
+        self.jpeg = jpeg
+        self._reduced = {}  # DCT scale -> decoded image
+        self.timestamp = time.time() if timestamp is None else timestamp
+        self.sequence = sequence
+        self.camera_id = camera_id
+    
+    @property
+    def image(self):
+        """Full-resolution BGR image (decoded on first access)."""
+        if self._image is None:
+            self._image = self._decode(1)
+        return self._image
+    
+    def image_for(self, size):
+        """
+        Image at least the given size, for consumers that will shrink it.
+        
+        Uses the full image if it has already been decoded; otherwise
+        decodes the JPEG at the smallest DCT scale that covers size.
+        
+        Args:
+            size: Needed (width, height)
+        """
+        if self._image is not None:
+            return self._image
+        full = jpeg_size(self.jpeg)
+        scale = jpeg_scale(full, size) if full is not None else 1
+        if scale == 1:
+            return self.image
+        image = self._reduced.get(scale)
+        if image is None:
+            image = self._reduced[scale] = self._decode(scale)
+        return image
+    
+    def _decode(self, scale):
+        image = cv2.imdecode(np.frombuffer(self.jpeg, dtype=np.uint8), SCALE_FLAGS[scale])
+        if image is None:
+            raise ValueError(f"Failed to decode frame {self.sequence}")
+        image.flags.writeable = False
+        return image
+    
+    @property
+    def shape(self):
+        if self._image is None:
+            size = jpeg_size(self.jpeg)
+            if size is not None:
+                return (size[1], size[0], 3)
+        return self.image.shape
+    
+    def __repr__(self):
+        return f"Frame(camera={self.camera_id}, seq={self.sequence}, shape={self.shape})"
+
+
+class FrameBroadcaster:
+    """Single capture thread publishing frames to any number of readers."""
+    
+    def __init__(self, source, size=4, max_fps=15, name='FrameBroadcaster'):
+        """
+        Start the capture thread.
+        
+        Args:
+            source: Callable returning the next Frame (or None on failure);
+                only ever called from the capture thread
+            size: Frames kept in the ring
+            max_fps: Capture rate limit (0 for as fast as the source allows)
+            name: Capture thread name
+        """
+        self.source = source
+        self.size = size
+        self.min_period = 1.0 / max_fps if max_fps else 0.0
+        
+        # Readers index the ring by sequence without locking: the slot is
+        # written before the sequence is published, and both are single
+        # reference assignments
+        self.ring = [None] * size
+        self.sequence = 0
+        self.failures = 0
+        
+        # Only used to wake readers waiting for the next frame
+        self.new_frame = threading.Condition()
+        
+        self.running = True
+        self.thread = threading.Thread(target=self._capture_loop, name=name, daemon=True)
+        self.thread.start()
+    
+    def _capture_loop(self):
+        while self.running:
+            started = time.monotonic()
+            try:
+                frame = self.source()
+            except Exception as e:
+                logger.error(f"Frame source failed: {e}")
+                frame = None
+            
+            if frame is None:
+                self.failures += 1
+                time.sleep(0.1)
+                continue
+            
+            self.publish(frame)
+            
+            remaining = self.min_period - (time.monotonic() - started)
+            if remaining > 0:
+                time.sleep(remaining)
+    
+    def publish(self, frame):
+        """Make a frame the latest one and wake waiting readers."""
+        sequence = self.sequence + 1
+        self.ring[sequence % self.size] = frame
+        self.sequence = sequence
+        with self.new_frame:
+            self.new_frame.notify_all()
+    
+    def latest(self):
+        """Most recent frame, or None before the first capture."""
+        sequence = self.sequence
+        return self.ring[sequence % self.size] if sequence else None
+    
+    def get(self, sequence):
+        """Frame by broadcast sequence number, if it is still in the ring."""
+        if sequence <= 0 or sequence > self.sequence or self.sequence - sequence >= self.size:
+            return None
+        return self.ring[sequence % self.size]
+    
+    def wait(self, after=0, timeout=1.0):
+        """
+        Wait for a frame newer than a broadcast sequence number.
+        
+        Readers that fall behind skip straight to the latest frame.
+        
+        Args:
+            after: Broadcast sequence of the last frame the reader saw
+            timeout: Seconds to wait
+            
+        Returns:
+            (sequence, Frame), or (after, None) on timeout
+        """
+        if self.sequence <= after:
+            with self.new_frame:
+                self.new_frame.wait_for(lambda: self.sequence > after or not self.running, timeout)
+        
+        sequence = self.sequence
+        if sequence <= after:
+            return after, None
+        return sequence, self.ring[sequence % self.size]
+    
+    def close(self):
+        """Stop the capture thread."""
+        self.running = False
+        with self.new_frame:
+            self.new_frame.notify_all()
+        self.thread.join(timeout=5)
@@ -0,0 +1,499 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Long-Term History Store
+
+Embedded, append-only columnar store for sensor time series. Every series
+(e.g. 'water_level_cm') lives in its own file under data/history/ as a
+sequence of sealed chunks:
+
+    header      CHUNK_HEADER (magic, count, first/last timestamp, sizes, crc)
+    timestamps  delta-of-delta encoded int64 milliseconds, narrowed + zlib
+    values      Gorilla-style XOR of consecutive float64 bit patterns,
+                byte-plane shuffled + zlib
+
+Encoding and decoding are fully vectorized with numpy (cumsum and
+bitwise_xor.accumulate), and files are only ever appended to, so readers
+can mmap them while the writer is active. Chunk headers carry the time
+range, so range scans skip chunks without decompressing them.
+
+Each series also maintains min/max/mean/last rollups (see rollups.py);
+query() serves long time ranges from the coarsest suitable tier.
+"""
+
+import logging
+import mmap
+import struct
+import threading
+import time
+import zlib
+from collections import OrderedDict
+from pathlib import Path
+
+import numpy as np
+
+from rollups import ROLLUP_TIERS, SeriesRollups
+
+logger = logging.getLogger('DrainSentinel.History')
+
+# magic, version, ts dtype code, count, t_first, t_last, ts bytes, value bytes, crc32
+CHUNK_HEADER = struct.Struct('<4sBBHIqqIII')
+CHUNK_MAGIC = b'DSCK'
+CHUNK_VERSION = 1
+
+# Narrowest integer type that holds every delta-of-delta in a chunk
+TS_DTYPES = [np.int8, np.int16, np.int32, np.int64]
+
+
+def encode_timestamps(ts_ms):
+    """
+    Delta-of-delta encode int64 millisecond timestamps.
+    
+    Returns:
+        (dtype code, compressed bytes). The first timestamp is stored in the
+        chunk header, so only the second-order differences are written.
+    """
+    deltas = np.diff(ts_ms, prepend=ts_ms[0])
+    dod = np.diff(deltas, prepend=0)
+    
+    code = 3
+    if len(dod):
+        lo, hi = int(dod.min()), int(dod.max())
+        for i, dtype in enumerate(TS_DTYPES):
+            info = np.iinfo(dtype)
+            if info.min <= lo and hi <= info.max:
+                code = i
+                break
+    
+    return code, zlib.compress(dod.astype(TS_DTYPES[code]).tobytes(), 1)
+
+
+def decode_timestamps(payload, code, count, t_first):
+    """Inverse of encode_timestamps(); returns int64 milliseconds."""
+    dod = np.frombuffer(zlib.decompress(payload), dtype=TS_DTYPES[code], count=count)
+    ts = np.cumsum(np.cumsum(dod, dtype=np.int64))
+    ts += t_first
+    return ts
+
+
+def encode_values(values):
+    """
+    Gorilla-style XOR encode float64 values.
+    
+    Consecutive readings of a slowly changing level share sign, exponent and
+    most mantissa bits, so the XOR with the previous value is mostly zero
+    bytes. Grouping byte planes together lets zlib collapse those runs.
+    """
+    bits = np.ascontiguousarray(values, dtype=np.float64).view(np.uint64)
+    xored = bits ^ np.concatenate((np.zeros(1, dtype=np.uint64), bits[:-1]))
+    planes = xored.view(np.uint8).reshape(-1, 8).T
+    return zlib.compress(np.ascontiguousarray(planes).tobytes(), 1)
+
+
+def decode_values(payload, count):
+    """Inverse of encode_values()."""
+    planes = np.frombuffer(zlib.decompress(payload), dtype=np.uint8).reshape(8, count)
+    xored = np.ascontiguousarray(planes.T).view(np.uint64).ravel()
+    return np.bitwise_xor.accumulate(xored).view(np.float64)
+
+
+class SeriesFile:
+    """One append-only chunk file holding a single series."""
+    
+    def __init__(self, path, cache_points=1_000_000):
+        """
+        Open (or create) a series file.
+        
+        Args:
+            path: Path to the .dts file
+            cache_points: Decoded points kept in memory for repeated scans
+        """
+        self.path = Path(path)
+        self.path.touch(exist_ok=True)
+        
+        # Chunk index: rows of (offset, count, t_first, t_last)
+        self.index = []
+        self.indexed_bytes = 0
+        
+        # Sealed chunks never change, so decoded copies stay valid
+        self.cache = OrderedDict()
+        self.cache_points = cache_points
+        self.cached_points = 0
+        
+        self._recover()
+    
+    def _recover(self):
+        """Index existing chunks and drop a torn chunk left by a crash."""
+        self.refresh()
+        size = self.path.stat().st_size
+        if size > self.indexed_bytes:
+            logger.warning(f"Truncating {size - self.indexed_bytes} torn bytes from {self.path.name}")
+            with open(self.path, 'r+b') as f:
+                f.truncate(self.indexed_bytes)
+    
+    def refresh(self):
+        """Extend the chunk index with any chunks appended since last call."""
+        size = self.path.stat().st_size
+        if size <= self.indexed_bytes:
+            return
+        
+        with open(self.path, 'rb') as f:
+            with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+                offset = self.indexed_bytes
+                while offset + CHUNK_HEADER.size <= size:
+                    (magic, version, code, _, count, t_first, t_last,
+                     ts_len, val_len, crc) = CHUNK_HEADER.unpack_from(mm, offset)
+                    end = offset + CHUNK_HEADER.size + ts_len + val_len
+                    if magic != CHUNK_MAGIC or version != CHUNK_VERSION or end > size:
+                        break
+                    body = mm[offset + CHUNK_HEADER.size:end]
+                    if zlib.crc32(body) != crc:
+                        break
+                    self.index.append((offset, count, t_first, t_last))
+                    offset = end
+                self.indexed_bytes = offset
+    
+    def append_chunk(self, ts_ms, values):
+        """Encode and append one chunk."""
+        code, ts_payload = encode_timestamps(ts_ms)
+        val_payload = encode_values(values)
+        body = ts_payload + val_payload
+        
+        header = CHUNK_HEADER.pack(
+            CHUNK_MAGIC, CHUNK_VERSION, code, 0, len(ts_ms),
+            int(ts_ms[0]), int(ts_ms[-1]),
+            len(ts_payload), len(val_payload), zlib.crc32(body)
+        )
+        
+        with open(self.path, 'ab') as f:
+            f.write(header + body)
+        
+        self.index.append((self.indexed_bytes, len(ts_ms), int(ts_ms[0]), int(ts_ms[-1])))
+        self.indexed_bytes += len(header) + len(body)
+    
+    def _decode_chunk(self, mm, offset, count, t_first):
+        """Decode one chunk, going through the decoded-chunk LRU."""
+        cached = self.cache.get(offset)
+        if cached is not None:
+            self.cache.move_to_end(offset)
+            return cached
+        
+        (_, _, code, _, _, _, _, ts_len, val_len, _) = CHUNK_HEADER.unpack_from(mm, offset)
+        body = offset + CHUNK_HEADER.size
+        decoded = (
+            decode_timestamps(mm[body:body + ts_len], code, count, t_first),
+            decode_values(mm[body + ts_len:body + ts_len + val_len], count),
+        )
+        
+        if count <= self.cache_points:
+            self.cache[offset] = decoded
+            self.cached_points += count
+            while self.cached_points > self.cache_points:
+                _, (old_ts, _) = self.cache.popitem(last=False)
+                self.cached_points -= len(old_ts)
+        
+        return decoded
+    
+    def scan(self, start_ms=None, end_ms=None):
+        """
+        Decode every chunk overlapping [start_ms, end_ms].
+        
+        Returns:
+            (timestamps int64 ms, values float64) numpy arrays
+        """
+        self.refresh()
+        chunks = [
+            c for c in self.index
+            if (start_ms is None or c[3] >= start_ms) and (end_ms is None or c[2] <= end_ms)
+        ]
+        if not chunks:
+            return np.empty(0, dtype=np.int64), np.empty(0, dtype=np.float64)
+        
+        total = sum(c[1] for c in chunks)
+        ts_out = np.empty(total, dtype=np.int64)
+        val_out = np.empty(total, dtype=np.float64)
+        
+        with open(self.path, 'rb') as f:
+            with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+                pos = 0
+                for offset, count, t_first, _ in chunks:
+                    ts, values = self._decode_chunk(mm, offset, count, t_first)
+                    ts_out[pos:pos + count] = ts
+                    val_out[pos:pos + count] = values
+                    pos += count
+        
+        # Only the boundary chunks can hold points outside the range
+        lo = 0 if start_ms is None else np.searchsorted(ts_out, start_ms, 'left')
+        hi = total if end_ms is None else np.searchsorted(ts_out, end_ms, 'right')
+        return ts_out[lo:hi], val_out[lo:hi]
+
+
+class HistoryStore:
+    """Persistent, compressed history for all sensor series."""
+    
+    def __init__(self, data_dir='data/history', chunk_points=3600, flush_interval=300,
+                 rollup_tiers=ROLLUP_TIERS, snapshot_interval=86400):
+        """
+        Initialize the history store.
+        
+        Args:
+            data_dir: Directory holding one .dts file per series
+            chunk_points: Points buffered in memory before a chunk is sealed
+            flush_interval: Seal a partial chunk after this many seconds, which
+                bounds how much history a power cut can lose
+            rollup_tiers: List of (bucket width seconds, capacity) for rollups
+            snapshot_interval: Seconds between rollup snapshots. Rollups are
+                caught up from raw chunks on startup, so this only bounds
+                how much raw data has to be replayed after a crash.
+        """
+        self.data_dir = Path(data_dir)
+        self.data_dir.mkdir(parents=True, exist_ok=True)
+        self.rollup_dir = self.data_dir / 'rollups'
+        self.rollup_dir.mkdir(exist_ok=True)
+        self.chunk_points = chunk_points
+        self.flush_interval = flush_interval
+        self.rollup_tiers = rollup_tiers
+        self.snapshot_interval = snapshot_interval
+        
+        self.files = {}
+        self.buffers = {}  # series -> (timestamps ms list, values list, opened_at)
+        self.rollups = {}
+        self.last_snapshot = time.time()
+        self.lock = threading.Lock()
+        
+        for path in sorted(self.data_dir.glob('*.dts')):
+            self.files[path.stem] = SeriesFile(path)
+            self._load_rollups(path.stem)
+        
+        logger.info(f"HistoryStore initialized: {len(self.files)} series in {self.data_dir}")
+    
+    def _file(self, series):
+        """Get (or create) the file for a series."""
+        if series not in self.files:
+            self.files[series] = SeriesFile(self.data_dir / f"{series}.dts")
+        return self.files[series]
+    
+    def _load_rollups(self, series):
+        """Restore a series' rollups from its snapshot and replay newer raw chunks."""
+        rollups = self.rollups[series] = SeriesRollups(self.rollup_tiers)
+        
+        snapshot = self.rollup_dir / f"{series}.npz"
+        since_ms = None
+        if snapshot.exists() and rollups.load(snapshot) and rollups.last_timestamp:
+            since_ms = int(round(rollups.last_timestamp * 1000)) + 1
+        
+        # Replay a day at a time so a first start over a long history stays bounded in memory
+        f = self.files[series]
+        f.refresh()
+        if not f.index:
+            return
+        cursor = max(since_ms or 0, f.index[0][2])
+        last = f.index[-1][3]
+        replayed = 0
+        while cursor <= last:
+            ts, values = f.scan(cursor, cursor + 86_400_000 - 1)
+            rollups.extend(ts / 1000.0, values)
+            replayed += len(ts)
+            cursor += 86_400_000
+        
+        if replayed:
+            logger.info(f"Rollups for {series}: replayed {replayed} raw points")
+    
+    def _save_rollups(self):
+        """Snapshot rollups of every series (lock held)."""
+        for series, rollups in self.rollups.items():
+            try:
+                rollups.save(self.rollup_dir / f"{series}.npz")
+            except Exception as e:
+                logger.error(f"Failed to save rollups for {series}: {e}")
+        self.last_snapshot = time.time()
+    
+    def append(self, series, timestamp, value):
+        """
+        Append one sample.
+        
+        Args:
+            series: Series name (e.g. 'water_level_cm')
+            timestamp: Unix time in seconds
+            value: Sample value
+        """
+        with self.lock:
+            buf = self.buffers.get(series)
+            if buf is None:
+                buf = self.buffers[series] = ([], [], time.time())
+            
+            ts_ms = int(timestamp * 1000)
+            # Keep chunks monotonic even if the wall clock steps back
+            if buf[0] and ts_ms < buf[0][-1]:
+                ts_ms = buf[0][-1]
+            
+            buf[0].append(ts_ms)
+            buf[1].append(float(value))
+            
+            rollups = self.rollups.get(series)
+            if rollups is None:
+                rollups = self.rollups[series] = SeriesRollups(self.rollup_tiers)
+            rollups.add(ts_ms / 1000.0, float(value))
+            
+            if len(buf[0]) >= self.chunk_points or time.time() - buf[2] >= self.flush_interval:
+                self._seal(series)
+            
+            if time.time() - self.last_snapshot >= self.snapshot_interval:
+                self._save_rollups()
+    
+    def _seal(self, series):
+        """Write the buffered points of a series as a chunk (lock held)."""
+        buf = self.buffers.pop(series, None)
+        if not buf or not buf[0]:
+            return
+        
+        try:
+            self._file(series).append_chunk(
+                np.array(buf[0], dtype=np.int64),
+                np.array(buf[1], dtype=np.float64)
+            )
+        except Exception as e:
+            logger.error(f"Failed to write history chunk for {series}: {e}")
+    
+    def flush(self, series=None):
+        """Seal buffered points of one or all series."""
+        with self.lock:
+            for name in ([series] if series else list(self.buffers)):
+                self._seal(name)
+    
+    def scan(self, series, start=None, end=None):
+        """
+        Read a time range of a series, including unsealed points.
+        
+        Args:
+            series: Series name
+            start: Start time (Unix seconds), or None for the beginning
+            end: End time (Unix seconds), or None for the latest point
+        
+        Returns:
+            (timestamps in Unix seconds, values) numpy float64 arrays
+        """
+        start_ms = None if start is None else int(start * 1000)
+        end_ms = None if end is None else int(end * 1000)
+        
+        with self.lock:
+            f = self.files.get(series)
+            buf = self.buffers.get(series)
+            pending_ts = np.array(buf[0] if buf else [], dtype=np.int64)
+            pending_val = np.array(buf[1] if buf else [], dtype=np.float64)
+            
+            if f is not None:
+                ts, values = f.scan(start_ms, end_ms)
+            else:
+                ts, values = np.empty(0, dtype=np.int64), np.empty(0, dtype=np.float64)
+        
+        if len(pending_ts):
+            mask = np.ones(len(pending_ts), dtype=bool)
+            if start_ms is not None:
+                mask &= pending_ts >= start_ms
+            if end_ms is not None:
+                mask &= pending_ts <= end_ms
+            ts = np.concatenate((ts, pending_ts[mask]))
+            values = np.concatenate((values, pending_val[mask]))
+        
+        return ts / 1000.0, values
+    
+    def query(self, series, start=None, end=None, resolution=1.0):
+        """
+        Read a time range at a given resolution.
+        
+        Picks the coarsest rollup tier whose buckets are no wider than the
+        requested resolution, falling back to raw samples below 1 s.
+        
+        Args:
+            series: Series name
+            start: Start time (Unix seconds), or None
+            end: End time (Unix seconds), or None
+            resolution: Desired spacing between points in seconds
+        
+        Returns:
+            Dictionary of numpy arrays (timestamp, min, max, mean, last, count)
+            plus 'resolution', the bucket width used (0 for raw samples)
+        """
+        with self.lock:
+            rollups = self.rollups.get(series)
+            tier = rollups.pick_tier(resolution, start) if rollups else None
+            if tier is not None:
+                result = tier.query(start, end)
+                result['resolution'] = tier.width
+                return result
+        
+        ts, values = self.scan(series, start, end)
+        return {
+            'timestamp': ts, 'min': values, 'max': values, 'mean': values,
+            'last': values, 'count': np.ones(len(ts), dtype=np.int64),
+            'resolution': 0,
+        }
+    
+    def series(self):
+        """List all known series names."""
+        with self.lock:
+            return sorted(set(self.files) | set(self.buffers))
+    
+    def close(self):
+        """Flush all buffered points and rollup snapshots to disk."""
+        self.flush()
+        with self.lock:
+            self._save_rollups()
+        logger.info("HistoryStore closed")
+
+
+def test_history_store():
+    """Test the history store round trip and measure scan throughput."""
+    import tempfile
+    
+    print("Testing history store...")
+    
+    with tempfile.TemporaryDirectory() as tmp:
+        store = HistoryStore(tmp, chunk_points=3600)
+        
+        # One week of 1 Hz samples with jittery timestamps and a noisy level
+        n = 7 * 24 * 3600
+        t0 = time.time() - n
+        ts = t0 + np.arange(n) + np.random.uniform(-0.02, 0.02, n)
+        levels = np.round(50 + 10 * np.sin(np.arange(n) / 3600) + np.random.normal(0, 0.3, n), 1)
+        
+        start = time.perf_counter()
+        for t, v in zip(ts, levels):
+            store.append('water_level_cm', t, v)
+        store.close()
+        print(f"  Ingest: {n / (time.perf_counter() - start):,.0f} points/s")
+        
+        size = (Path(tmp) / 'water_level_cm.dts').stat().st_size
+        print(f"  Size: {size / n:.2f} bytes/point (raw: 16)")
+        
+        reopened = HistoryStore(tmp)
+        start = time.perf_counter()
+        read_ts, read_values = reopened.scan('water_level_cm')
+        elapsed = time.perf_counter() - start
+        print(f"  Full scan (cold): {n / elapsed / 1e6:.1f} M points/s")
+        
+        start = time.perf_counter()
+        reopened.scan('water_level_cm')
+        elapsed = time.perf_counter() - start
+        print(f"  Full scan (cached): {n / elapsed / 1e6:.1f} M points/s")
+        
+        ok = (len(read_ts) == n and np.array_equal(read_values, levels)
+              and np.allclose(read_ts, ts, atol=0.0011))
+        
+        start = time.perf_counter()
+        day_ts, _ = reopened.scan('water_level_cm', t0 + 3 * 86400, t0 + 4 * 86400)
+        print(f"  One-day range scan: {len(day_ts)} points in "
+              f"{(time.perf_counter() - start) * 1000:.2f} ms")
+        
+        start = time.perf_counter()
+        week = reopened.query('water_level_cm', t0, t0 + n, resolution=3600)
+        print(f"  One-week query at {week['resolution']} s: {len(week['timestamp'])} buckets in "
+              f"{(time.perf_counter() - start) * 1000:.3f} ms")
+        ok = ok and week['resolution'] == 3600 and np.isclose(week['count'].sum(), n)
+        
+        print("History store test PASSED" if ok else "History store test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO)
+    test_history_store()
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Scaled JPEG Decoding
+
+Decodes JPEGs (camera MJPEG frames and stored captures) close to the size
+they are needed at. libjpeg(-turbo) can run the inverse DCT at 1/2, 1/4
+or 1/8 scale, which skips most of the decode work; OpenCV exposes this
+through the IMREAD_REDUCED_COLOR_* flags. The scale is picked from the
+dimensions in the JPEG's SOF header so the decoded image is never smaller
+than the target, and the caller finishes with a small resize.
+
+Also restores the Huffman tables that many USB webcams leave out of their
+MJPEG frames, so those frames can be decoded and stored as-is.
+"""
+
+import logging
+import time
+
+import cv2
+import numpy as np
+
+logger = logging.getLogger('DrainSentinel.JPEG')
+
+# DCT scale denominator -> imdecode flag
+SCALE_FLAGS = {
+    1: cv2.IMREAD_COLOR,
+    2: cv2.IMREAD_REDUCED_COLOR_2,
+    4: cv2.IMREAD_REDUCED_COLOR_4,
+    8: cv2.IMREAD_REDUCED_COLOR_8,
+}
+
+# Start-of-frame markers (every SOFn except DHT, JPG and DAC)
+_SOF_MARKERS = set(range(0xC0, 0xD0)) - {0xC4, 0xC8, 0xCC}
+
+_standard_dht = None
+
+
+def jpeg_size(data):
+    """
+    Image dimensions from a JPEG header, without decoding.
+    
+    Args:
+        data: JPEG bytes (only the header needs to be present)
+    
+    Returns:
+        (width, height), or None if this is not a parseable JPEG
+    """
+    if len(data) < 4 or data[0] != 0xFF or data[1] != 0xD8:
+        return None
+    
+    pos = 2
+    while pos + 9 <= len(data):
+        if data[pos] != 0xFF:
+            return None
+        marker = data[pos + 1]
+        if marker == 0xFF:  # Fill byte
+            pos += 1
+            continue
+        if marker in _SOF_MARKERS:
+            height = (data[pos + 5] << 8) | data[pos + 6]
+            width = (data[pos + 7] << 8) | data[pos + 8]
+            return width, height
+        if marker == 0xDA:  # Start of scan without a frame header
+            return None
+        pos += 2 + ((data[pos + 2] << 8) | data[pos + 3])
+    return None
+
+
+def jpeg_scale(size, target_size):
+    """
+    Largest DCT scale denominator that keeps the image at least target size.
+    
+    Args:
+        size: Full image (width, height)
+        target_size: Needed (width, height)
+    """
+    for scale in (8, 4, 2):
+        # libjpeg rounds scaled dimensions up
+        if -(-size[0] // scale) >= target_size[0] and -(-size[1] // scale) >= target_size[1]:
+            return scale
+    return 1
+
+
+def decode_jpeg(data, target_size=None):
+    """
+    Decode a JPEG (or any image OpenCV reads) to BGR.
+    
+    Args:
+        data: Encoded image bytes
+        target_size: (width, height) the image will be shrunk to; the
+            decode runs at the smallest DCT scale that still covers it.
+            None decodes at full resolution.
+    
+    Returns:
+        BGR numpy array, or None if decoding failed
+    """
+    scale = 1
+    if target_size is not None:
+        size = jpeg_size(data)
+        if size is not None:
+            scale = jpeg_scale(size, target_size)
+    
+    return cv2.imdecode(np.frombuffer(data, dtype=np.uint8), SCALE_FLAGS[scale])
+
+
+def read_image(path, target_size=None):
+    """
+    Load an image file, decoding JPEGs at reduced scale when possible.
+    
+    Returns:
+        BGR numpy array, or None if the file couldn't be read or decoded
+    """
+    try:
+        with open(path, 'rb') as f:
+            data = f.read()
+    except OSError as e:
+        logger.error(f"Failed to read image {path}: {e}")
+        return None
+    return decode_jpeg(data, target_size)
+
+
+def ensure_huffman_tables(data):
+    """
+    Insert the standard Huffman tables into an MJPEG frame that lacks them.
+    
+    Many UVC webcams omit the DHT segment and rely on the decoder to assume
+    the JPEG Annex K defaults. Without it the frame isn't a valid JPEG
+    file. Frames that already have tables are returned unchanged.
+    """
+    global _standard_dht
+    
+    pos = 2
+    while pos + 4 <= len(data):
+        if data[pos] != 0xFF:
+            return data
+        marker = data[pos + 1]
+        if marker == 0xC4:  # Has tables
+            return data
+        if marker == 0xDA or marker in _SOF_MARKERS:
+            break
+        pos += 2 + ((data[pos + 2] << 8) | data[pos + 3])
+    else:
+        return data
+    
+    if _standard_dht is None:
+        _standard_dht = _extract_dht()
+    return data[:pos] + _standard_dht + data[pos:]
+
+
+def _extract_dht():
+    """The Annex K tables, taken from a JPEG libjpeg encodes with defaults."""
+    ok, jpeg = cv2.imencode('.jpg', np.zeros((16, 16, 3), dtype=np.uint8))
+    data = jpeg.tobytes()
+    segments = []
+    pos = 2
+    while pos + 4 <= len(data) and data[pos + 1] != 0xDA:
+        length = (data[pos + 2] << 8) | data[pos + 3]
+        if data[pos + 1] == 0xC4:
+            segments.append(data[pos:pos + 2 + length])
+        pos += 2 + length
+    return b''.join(segments)
+
+
+def benchmark_decode(iterations=50):
+    """Compare full decode + preprocess with scaled decode + preprocess for a 1280x720 frame."""
+    from preprocess import Preprocessor
+    
+    print("Benchmarking scaled JPEG decode (1280x720 frame, quality 80)...")
+    
+    # Smooth textured scene with mild sensor noise, at a typical webcam MJPEG quality
+    y, x = np.mgrid[0:720, 0:1280]
+    base = 128 + 60 * np.sin(x / 37.0) * np.cos(y / 23.0) + np.random.normal(0, 2, (720, 1280))
+    image = np.clip(np.dstack([base, base * 0.8 + 20, 255 - base]), 0, 255).astype(np.uint8)
+    data = cv2.imencode('.jpg', image, [cv2.IMWRITE_JPEG_QUALITY, 80])[1].tobytes()
+    
+    def timed(fn):
+        fn()
+        start = time.perf_counter()
+        for _ in range(iterations):
+            fn()
+        return (time.perf_counter() - start) / iterations * 1000
+    
+    ok = jpeg_size(data) == (1280, 720)
+    for size in ((224, 224), (96, 96)):
+        pre = Preprocessor(size, np.uint8)
+        full = timed(lambda: pre(decode_jpeg(data)))
+        scaled = timed(lambda: pre(decode_jpeg(data, size)))
+        reference = pre(decode_jpeg(data)).astype(np.int16)
+        error = np.abs(pre(decode_jpeg(data, size)).astype(np.int16) - reference).mean()
+        scale = jpeg_scale((1280, 720), size)
+        print(f"  -> {size[0]}x{size[1]}: full decode {full:.2f} ms, 1/{scale} decode {scaled:.2f} ms "
+              f"({full / scaled:.1f}x), mean abs difference {error:.2f} levels")
+        ok &= error < 3.0
+    
+    # A headerless-table MJPEG frame becomes decodable
+    stripped = bytearray()
+    pos = 2
+    stripped += data[:2]
+    while data[pos + 1] != 0xDA:
+        length = (data[pos + 2] << 8) | data[pos + 3]
+        if data[pos + 1] != 0xC4:
+            stripped += data[pos:pos + 2 + length]
+        pos += 2 + length
+    stripped = bytes(stripped + data[pos:])
+    restored = decode_jpeg(ensure_huffman_tables(stripped))
+    ok &= restored is not None and np.array_equal(restored, decode_jpeg(data))
+    
+    print("JPEG decode test PASSED" if ok else "JPEG decode test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    benchmark_decode()
@@ -19,6 +19,7 @@ Usage:
 """
 
 import argparse
+import functools
 import logging
 import signal
 import sys
@@ -32,10 +33,24 @@ sys.path.insert(0, str(Path(__file__).parent))
 
 # Local imports
 from camera import Camera
+from streaming import MJPEGStreamer
 from arduino_serial import get_arduino
 from ai_detector import BlockageDetector
 from alert_system import AlertSystem
 from dashboard import start_dashboard
+from history_store import HistoryStore
+from kalman import LevelKalmanFilter, sample_measurement
+from forecast import OverflowForecaster
+from sensor_health import SensorHealthMonitor
+from change_gate import ChangeGate
+from pipeline import Pipeline
+from scheduler import CaptureScheduler
+from temporal import BlockageFilter
+from roi import load_rois
+from calibrate import load_calibration
+from cascade import DetectorCascade
+from batching import BatchInferenceWorker
+from result_cache import shared_cache
 
 # Configure logging
 log_dir = Path('data/logs')
@@ -52,6 +67,45 @@ logging.basicConfig(
 logger = logging.getLogger('DrainSentinel')
 
 
+class CameraChannel:
+    """One camera's detection state: regions, change gate, smoothing and pipeline."""
+    
+    def __init__(self, name, camera, settings):
+        """
+        Args:
+            name: Camera name (status key, capture subdirectory)
+            camera: Camera instance
+            settings: Its entry in config['cameras']
+        """
+        self.name = name
+        self.camera = camera
+        self.settings = settings
+        self.rois = []
+        self.change_gate = None
+        self.blockage_filter = None
+        self.pipeline = None
+        self.state = {
+            'blockage_detected': False,
+            'blockage_confidence': 0,
+            'blockage_class': 'unknown',
+            'blockage_frame_class': 'unknown',
+            'blockage_roi': None,
+            'last_image_path': None,
+            'last_capture_id': None,
+        }
+    
+    def get_status(self):
+        store = self.camera.store
+        return {
+            **self.state,
+            'captures': store.get_stats() if store else None,
+            'rois': [roi.name for roi in self.rois],
+            'change_gate': self.change_gate.get_stats() if self.change_gate else None,
+            'blockage_filter': self.blockage_filter.get_stats() if self.blockage_filter else None,
+            'pipeline': self.pipeline.get_status() if self.pipeline else None,
+        }
+
+
 class DrainSentinel:
     """Main DrainSentinel application class."""
     
@@ -62,12 +116,37 @@ class DrainSentinel:
         
         # Configuration
         self.config = {
-            'camera_interval': 5,         # seconds between camera captures
+            'cameras': [                  # One entry per drain inlet camera
+                {'name': 'camera0', 'device_id': 0},  # Optional 'rois': [...] overrides calibration
+            ],
+            'camera_min_interval': 1,     # Fastest capture rate (seconds, RED / active scene)
+            'camera_max_interval': 60,    # Slowest capture rate (seconds, dry and static)
+            'camera_cpu_budget': 0.25,    # Max average fraction of a core used by detection
+            'camera_backend': 'auto',     # 'v4l2', 'opencv' or 'auto'
+            'camera_pixel_format': 'MJPG',  # V4L2 format: 'MJPG' or 'YUYV'
+            'camera_stream_fps': 15,      # Shared capture thread rate (detection + viewers)
+            'change_method': 'sad',       # Scene change signature: 'sad' or 'dhash'
+            'change_threshold': 3.0,      # Grey levels (sad) or bits (dhash) to re-run the model
+            'max_inference_interval': 600,  # Run the model at least this often (seconds)
+            'cascade_enabled': True,      # Screen frames with the simple detector (once calibrated)
+            'pipeline_queue_size': 2,     # Frames buffered between detection stages (oldest dropped)
+            'inference_batch_deadline_ms': 50,  # Longest a frame waits to share a model call
             'sensor_interval': 1,         # Arduino sends every 1 second
             'alert_check_interval': 10,   # seconds between alert checks
             'water_level_critical': 80,   # percentage threshold for critical
             'water_level_warning': 50,    # percentage threshold for warning
-            'blockage_threshold': 0.6,    # AI confidence threshold
+            'blockage_threshold': 0.6,    # Smoothed blockage probability to report a blockage
+            'blockage_clear_threshold': 0.4,  # ...and to report clear again (hysteresis)
+            'blockage_time_constant': 15, # Seconds of evidence averaged per decision
+            'save_captures': True,        # Write captures to disk (in background)
+            'capture_store_mb': 512,      # Capture ring size per camera (preallocated)
+            'capture_max_age_hours': 72,  # Captures older than this are dropped
+            'capture_pinned_mb': 256,     # Budget for captures kept around alerts
+            'capture_pin_window': 600,    # Seconds kept either side of an ORANGE/RED alert
+            'capture_dedup_bits': 3,      # dhash bits a capture must differ by to be stored
+            'capture_keyframe_interval': 3600,  # Store a full capture at least this often
+            'level_process_noise': 1e-5,  # Kalman acceleration noise (cm^2/s^3)
+            'level_measurement_variance': 1.0,  # cm^2, when no echo spread is sent
         }
         
         # Initialize components
@@ -77,13 +156,33 @@ class DrainSentinel:
         logger.info("")
         logger.info("Initializing components...")
         
-        # Camera (always try to initialize)
-        try:
-            self.camera = Camera()
-            logger.info("✓ Camera initialized")
-        except Exception as e:
-            logger.warning(f"✗ Camera failed: {e}")
-            self.camera = None
+        # Cameras (always try to initialize); the first saves to data/captures,
+        # others to a subdirectory named after them
+        self.channels = []
+        store_options = {
+            'capacity_mb': self.config['capture_store_mb'],
+            'max_age': self.config['capture_max_age_hours'] * 3600,
+            'pinned_mb': self.config['capture_pinned_mb'],
+            'dedup_bits': self.config['capture_dedup_bits'],
+            'keyframe_interval': self.config['capture_keyframe_interval'],
+        }
+        for i, settings in enumerate(self.config['cameras']):
+            name = settings.get('name', f"camera{i}")
+            try:
+                camera = Camera(settings.get('device_id', i),
+                                backend=self.config['camera_backend'],
+                                pixel_format=self.config['camera_pixel_format'],
+                                capture_dir='data/captures' if i == 0 else f"data/captures/{name}",
+                                store_options=store_options)
+                self.channels.append(CameraChannel(name, camera, settings))
+                logger.info(f"✓ Camera {name} initialized")
+            except Exception as e:
+                logger.warning(f"✗ Camera {name} failed: {e}")
+        self.camera = self.channels[0].camera if self.channels else None
+        
+        # Live video: each frame is encoded once per quality tier for all viewers
+        self.streamers = {channel.name: MJPEGStreamer(channel.camera) for channel in self.channels}
+        self.streamer = self.streamers[self.channels[0].name] if self.channels else None
         
         # Arduino (sensor hub)
         self.arduino = get_arduino(mock=test_mode)
@@ -98,6 +197,50 @@ class DrainSentinel:
             logger.warning(f"✗ AI Detector failed: {e}")
             self.detector = None
         
+        # Detection regions from the calibration wizard (empty: whole frame)
+        calibration = load_calibration()
+        for i, channel in enumerate(self.channels):
+            if 'rois' in channel.settings:
+                channel.rois = load_rois({'rois': channel.settings['rois']})
+            elif i == 0:
+                channel.rois = load_rois(calibration)
+        
+        # Screen frames with the cheap detector; the model only sees possible blockages
+        cascade = (calibration or {}).get('cascade')
+        if self.detector and self.config['cascade_enabled']:
+            if cascade:
+                self.detector = DetectorCascade(self.detector, cascade['threshold'])
+                logger.info(f"✓ Detector cascade enabled (screen threshold {cascade['threshold']:.3f})")
+            else:
+                logger.info("Detector cascade not calibrated (see cascade.py), running the model on every frame")
+        
+        for channel in self.channels:
+            # Skip inference while the drain view hasn't changed
+            channel.change_gate = ChangeGate(threshold=self.config['change_threshold'],
+                                             max_interval=self.config['max_inference_interval'],
+                                             method=self.config['change_method'])
+            
+            # Per-frame results are smoothed so a passing shadow doesn't raise an alert
+            channel.blockage_filter = BlockageFilter(time_constant=self.config['blockage_time_constant'],
+                                                     enter_threshold=self.config['blockage_threshold'],
+                                                     exit_threshold=self.config['blockage_clear_threshold'],
+                                                     name=channel.name)
+        
+        # One model serves every camera, batching frames that arrive together
+        self.inference = None
+        if self.detector and self.channels:
+            self.inference = BatchInferenceWorker(self.detector, max_batch=len(self.channels),
+                                                  deadline_ms=self.config['inference_batch_deadline_ms'])
+        
+        # Capture rate follows the flood risk, within a CPU budget
+        self.scheduler = CaptureScheduler(min_interval=self.config['camera_min_interval'],
+                                          max_interval=self.config['camera_max_interval'],
+                                          cpu_budget=self.config['camera_cpu_budget'])
+        
+        # Each camera's detection runs as pipelined stages (see pipeline.py)
+        for channel in self.channels:
+            channel.pipeline = self._build_pipeline(channel)
+        
         # Alert System
         self.alerts = AlertSystem(test_mode=test_mode)
         logger.info("✓ Alert system initialized")
@@ -109,16 +252,38 @@ class DrainSentinel:
             'blockage_detected': False,
             'blockage_confidence': 0,
             'blockage_class': 'unknown',
+            'blockage_frame_class': 'unknown',  # Latest single-frame result, before smoothing
+            'blockage_roi': None,  # Calibrated region with the most severe result
+            'blockage_camera': None,  # Camera with the most severe result
             'alert_level': 'GREEN',
             'last_image_path': None,
             'last_update': None,
             'rate_of_rise': 0,  # cm per minute
+            'water_level_filtered_cm': None,
+            'water_level_std_cm': None,
+            'level_velocity_cm_min': 0,
+            'level_covariance': None,
+            'minutes_to_critical': None,
+            'forecast': None,
+            'sensor_health': 'OK',  # OK / JUMP / SHIFT / STUCK / DROPOUT
         }
         
         # Historical data for trend analysis
         self.water_history = []  # List of (timestamp, level) tuples
         self.max_history = 3600  # Keep 1 hour of data (at 1/sec = 3600 points)
         
+        # Long-term history on disk (survives restarts)
+        self.history = HistoryStore()
+        
+        # Level estimate (smoothed level and rate of rise)
+        self.level_filter = LevelKalmanFilter(process_noise=self.config['level_process_noise'])
+        
+        # Time-to-overflow forecast (fitted to the last 10 minutes)
+        self.forecaster = OverflowForecaster(critical_level=self.config['water_level_critical'])
+        
+        # Level sensor fault detection (stuck, dropouts, impossible jumps)
+        self.sensor_health = SensorHealthMonitor()
+        
         # Register Arduino callback
         self.arduino.add_callback(self._on_sensor_data)
         
@@ -128,7 +293,14 @@ class DrainSentinel:
     
     def _on_sensor_data(self, data):
         """Callback when new sensor data arrives from Arduino."""
-        if not data.get('valid', False):
+        now = time.time()
+        valid = data.get('valid', False)
+        
+        # Track sensor health, including invalid samples
+        health, accepted = self.sensor_health.update(now, data.get('water_level_cm'), valid)
+        self.current_state['sensor_health'] = health
+        
+        if not valid:
             return
         
         # Update state
@@ -136,50 +308,122 @@ class DrainSentinel:
         self.current_state['water_level_percent'] = data.get('water_level_percent', 0)
         
         # Add to history
-        now = time.time()
         level = data.get('water_level_cm', 0)
         self.water_history.append((now, level))
+        self.history.append('water_level_cm', now, level)
+        self.history.append('water_level_percent', now, data.get('water_level_percent', 0))
         
         # Trim old history
         cutoff = now - self.max_history
         self.water_history = [(t, l) for t, l in self.water_history if t > cutoff]
         
-        # Calculate rate of rise (cm per minute)
-        if len(self.water_history) >= 60:  # Need at least 1 minute of data
-            old_time, old_level = self.water_history[-60]
-            new_time, new_level = self.water_history[-1]
-            time_diff = (new_time - old_time) / 60  # Convert to minutes
-            if time_diff > 0:
-                # Positive rate = water rising (distance decreasing)
-                self.current_state['rate_of_rise'] = (old_level - new_level) / time_diff
-    
-    def update_camera(self):
-        """Capture image and run blockage detection."""
-        if self.camera is None:
-            logger.debug("Camera not available")
+        # Impossible jumps are kept in history but not used for estimation
+        if not accepted:
             return
         
-        try:
-            # Capture image
-            image_path = self.camera.capture()
-            if image_path is None:
-                logger.warning("Failed to capture camera image")
-                return
-            
-            self.current_state['last_image_path'] = image_path
-            
-            # Run AI detection
-            if self.detector:
-                result = self.detector.detect(image_path)
-                
-                self.current_state['blockage_detected'] = result.get('blocked', False)
-                self.current_state['blockage_confidence'] = result.get('confidence', 0)
-                self.current_state['blockage_class'] = result.get('class_name', 'unknown')
-                
-                logger.debug(f"AI Detection: {result['class_name']} ({result['confidence']:.2%})")
+        # Update level estimate, weighting the sample by its echo quality
+        measurement = sample_measurement(data, self.config['level_measurement_variance'])
+        if measurement is not None:
+            estimate = self.level_filter.update(now, *measurement).get_state()
+            self.current_state['water_level_filtered_cm'] = estimate['level_cm']
+            self.current_state['water_level_std_cm'] = estimate['level_std_cm']
+            self.current_state['level_velocity_cm_min'] = estimate['velocity_cm_per_s'] * 60
+            self.current_state['level_covariance'] = estimate['covariance']
+            # Positive rate = water rising (distance decreasing)
+            self.current_state['rate_of_rise'] = -estimate['velocity_cm_per_s'] * 60
         
-        except Exception as e:
-            logger.error(f"Camera update error: {e}")
+        # Refresh time-to-critical forecast
+        self.forecaster.update(now, data.get('water_level_percent', 0))
+        forecast = self.forecaster.forecast().get('level')
+        self.current_state['forecast'] = forecast
+        self.current_state['minutes_to_critical'] = forecast['minutes_to_critical'] if forecast else None
+    
+    def _build_pipeline(self, channel):
+        """Detection stages: capture -> preprocess -> infer -> publish, each on its own thread."""
+        pipeline = Pipeline(interval=self._capture_interval)
+        pipeline.add_stage('capture', functools.partial(self._capture_stage, channel))
+        if self.detector:
+            size = self.config['pipeline_queue_size']
+            pipeline.add_stage('preprocess', functools.partial(self._preprocess_stage, channel), size)
+            pipeline.add_stage('infer', functools.partial(self._infer_stage, channel), size)
+            pipeline.add_stage('publish', functools.partial(self._publish_stage, channel), size)
+        return pipeline
+    
+    def _capture_interval(self):
+        """Seconds until the next capture, from the scheduler."""
+        # The CPU budget covers every camera together
+        cost = sum(channel.pipeline.cost() for channel in self.channels if channel.pipeline)
+        return self.scheduler.next_interval(self.current_state['alert_level'],
+                                            self.current_state['minutes_to_critical'],
+                                            cost=cost)
+    
+    def _capture_stage(self, channel, _):
+        """Grab the latest camera frame and queue it for saving."""
+        # Capture frame (stays in memory for detection)
+        frame = channel.camera.capture_frame()
+        if frame is None:
+            logger.warning(f"Failed to capture image from {channel.name}")
+            return None
+        
+        # Saving to disk happens on the camera's writer thread
+        if self.config['save_captures']:
+            capture_id = channel.camera.save_async(frame)
+            if capture_id is not None:
+                channel.state['last_capture_id'] = capture_id
+                channel.state['last_image_path'] = str(channel.camera.capture_dir / 'latest.jpg')
+                if channel is self.channels[0]:
+                    self.current_state['last_image_path'] = channel.state['last_image_path']
+        
+        return {'frame': frame}
+    
+    def _preprocess_stage(self, channel, job):
+        """Decode and preprocess the frame, unless the scene is unchanged."""
+        # Reuse the last result while the scene is unchanged
+        gate = channel.change_gate
+        infer, reason = gate.check(job['frame'])
+        logger.debug(f"{channel.name} change gate: {reason} (distance {gate.last_distance})")
+        self.scheduler.record_change(reason == 'changed')
+        
+        if infer:
+            job['signature'] = gate.pending
+            job['tensor'] = self.detector.prepare(job['frame'], channel.rois)
+        else:
+            job['result'] = gate.last_result
+        return job
+    
+    def _infer_stage(self, channel, job):
+        """Run the shared model on a preprocessed frame."""
+        if 'result' not in job:
+            job['result'] = self.inference.infer(job['tensor'], channel.rois)
+            channel.change_gate.commit(job['result'], signature=job['signature'])
+        return job
+    
+    def _publish_stage(self, channel, job):
+        """Fold the detection result into the camera's smoothed blockage state."""
+        result = job['result']
+        state = channel.blockage_filter.update(result, job['frame'].timestamp)
+        
+        channel.state['blockage_detected'] = state['blocked']
+        channel.state['blockage_confidence'] = state['confidence']
+        channel.state['blockage_class'] = state['class_name']
+        channel.state['blockage_frame_class'] = result.get('class_name', 'unknown')
+        channel.state['blockage_roi'] = result.get('roi')
+        self._merge_camera_states()
+        
+        logger.debug(f"AI Detection ({channel.name}): {result['class_name']} ({result['confidence']:.2%}), "
+                     f"smoothed {state['class_name']} ({state['confidence']:.2%})")
+        return job
+    
+    def _merge_camera_states(self):
+        """Site blockage state: that of the camera with the most severe result."""
+        severity = {'clear': 0, 'partial_blockage': 1, 'full_blockage': 2}
+        worst = max(self.channels, key=lambda channel: (channel.state['blockage_detected'],
+                                                        severity.get(channel.state['blockage_class'], -1),
+                                                        channel.state['blockage_confidence']))
+        for key in ('blockage_detected', 'blockage_confidence', 'blockage_class',
+                    'blockage_frame_class', 'blockage_roi'):
+            self.current_state[key] = worst.state[key]
+        self.current_state['blockage_camera'] = worst.name
     
     def calculate_alert_level(self):
         """Calculate the current alert level based on all factors."""
@@ -212,6 +456,10 @@ class DrainSentinel:
         if self._level_priority(level) > self._level_priority(old_level):
             self.alerts.send_alert(level, self.current_state)
             
+            # Keep the frames leading up to and following a serious alert
+            if self._level_priority(level) >= self._level_priority('ORANGE'):
+                self._pin_captures()
+            
             # Trigger relay for RED alerts
             if level == 'RED':
                 self._trigger_relay(True)
@@ -221,6 +469,14 @@ class DrainSentinel:
         
         logger.debug(f"Alert level: {level} (risk: {risk_score:.2%})")
     
+    def _pin_captures(self):
+        """Protect every camera's captures around now from ring retention."""
+        now = time.time()
+        window = self.config['capture_pin_window']
+        for channel in self.channels:
+            if channel.camera.store is not None:
+                channel.camera.store.pin(now - window, now + window)
+    
     def _level_priority(self, level):
         """Convert alert level to numeric priority."""
         priorities = {'GREEN': 0, 'YELLOW': 1, 'ORANGE': 2, 'RED': 3}
@@ -246,16 +502,6 @@ class DrainSentinel:
         except Exception as e:
             logger.warning(f"Relay control failed: {e}")
     
-    def run_camera_loop(self):
-        """Background loop for camera captures."""
-        while self.running:
-            try:
-                self.update_camera()
-                time.sleep(self.config['camera_interval'])
-            except Exception as e:
-                logger.error(f"Camera loop error: {e}")
-                time.sleep(1)
-    
     def run_alert_loop(self):
         """Background loop for alert checking."""
         while self.running:
@@ -272,9 +518,13 @@ class DrainSentinel:
         logger.info("Starting DrainSentinel monitoring...")
         self.running = True
         
+        # One thread reads each camera; detection and video viewers share its frames
+        for channel in self.channels:
+            channel.camera.start_broadcast(self.config['camera_stream_fps'])
+            channel.pipeline.start()
+        
         # Start background threads
         threads = [
-            threading.Thread(target=self.run_camera_loop, name='CameraLoop'),
             threading.Thread(target=self.run_alert_loop, name='AlertLoop'),
         ]
         
@@ -295,12 +545,19 @@ class DrainSentinel:
         self.running = False
         
         # Cleanup
-        if self.camera:
-            self.camera.release()
+        for channel in self.channels:
+            channel.pipeline.stop()
+        for streamer in self.streamers.values():
+            streamer.close()
+        for channel in self.channels:
+            channel.camera.release()
+        if self.inference:
+            self.inference.close()
         if self.arduino:
             self.arduino.close()
         if self.detector:
             self.detector.close()
+        self.history.close()
         
         # Ensure relay is off
         self._trigger_relay(False)
@@ -317,6 +574,13 @@ class DrainSentinel:
             'camera_available': self.camera is not None,
             'arduino_connected': hasattr(self.arduino, 'serial') and self.arduino.serial is not None,
             'ai_available': self.detector is not None,
+            'sensor_health_detail': self.sensor_health.get_status(),
+            'streaming': {name: streamer.get_stats() for name, streamer in self.streamers.items()},
+            'cameras': {channel.name: channel.get_status() for channel in self.channels},
+            'batching': self.inference.get_stats() if self.inference else None,
+            'result_cache': shared_cache().get_stats(),
+            'scheduler': self.scheduler.get_status(),
+            'cascade': self.detector.get_stats() if isinstance(self.detector, DetectorCascade) else None,
         }
 
 
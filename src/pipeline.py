@@ -0,0 +1,272 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Staged Detection Pipeline
+
+Runs camera detection as a chain of stages (capture -> preprocess ->
+infer -> publish), each on its own worker thread, connected by small
+bounded queues. While the model works on one frame the next is already
+being decoded and preprocessed, so a frame completes every max(stage)
+seconds instead of every sum(stages).
+
+Each queue has a single producer and a single consumer and drops its
+oldest item when full: a stalled stage never blocks the camera, and the
+stage after it always gets the freshest frame. Per-stage queue depth,
+drops and latency are reported by get_status() for tuning.
+
+A stage is a function taking the previous stage's item and returning the
+next one. Returning None ends that item's trip (e.g. the change gate
+decided it needs no inference and the result was published directly).
+"""
+
+import logging
+import threading
+import time
+from collections import deque
+
+logger = logging.getLogger('DrainSentinel.Pipeline')
+
+
+class DropOldestQueue:
+    """Bounded single-producer, single-consumer queue that discards its oldest item when full."""
+    
+    def __init__(self, maxsize=2):
+        self.maxsize = maxsize
+        self.items = deque()
+        self.cond = threading.Condition()
+        self.dropped = 0
+        self.closed = False
+    
+    def put(self, item):
+        """Add an item, evicting the oldest if full. Never blocks."""
+        with self.cond:
+            if len(self.items) >= self.maxsize:
+                self.items.popleft()
+                self.dropped += 1
+            self.items.append(item)
+            self.cond.notify()
+    
+    def get(self, timeout=None):
+        """
+        Remove and return the oldest item.
+        
+        Returns:
+            The item, or None on timeout or after close()
+        """
+        with self.cond:
+            if not self.cond.wait_for(lambda: self.items or self.closed, timeout):
+                return None
+            return self.items.popleft() if self.items else None
+    
+    def close(self):
+        """Wake the consumer; get() returns None from now on once empty."""
+        with self.cond:
+            self.closed = True
+            self.cond.notify_all()
+    
+    def __len__(self):
+        return len(self.items)
+
+
+class Stage:
+    """One pipeline stage: a function, its worker thread, and its input queue."""
+    
+    def __init__(self, name, fn, queue_size=2):
+        """
+        Initialize the stage.
+        
+        Args:
+            name: Stage name (thread name and status key)
+            fn: Called with each input item; returns the output item or None
+            queue_size: Input queue capacity (ignored for the first stage)
+        """
+        self.name = name
+        self.fn = fn
+        self.input = DropOldestQueue(queue_size)
+        self.output = None  # Next stage's input queue
+        self.thread = None
+        
+        self.processed = 0
+        self.errors = 0
+        self.busy_time = 0.0
+        self.latency_ms = None      # Exponential moving average
+        self.max_latency_ms = 0.0
+    
+    def run_once(self, item):
+        """Process one item and pass the result on."""
+        start = time.perf_counter()
+        try:
+            out = self.fn(item)
+        except Exception as e:
+            self.errors += 1
+            logger.error(f"{self.name} stage error: {e}")
+            out = None
+        elapsed = time.perf_counter() - start
+        
+        ms = elapsed * 1000
+        self.processed += 1
+        self.busy_time += elapsed
+        self.latency_ms = ms if self.latency_ms is None else 0.9 * self.latency_ms + 0.1 * ms
+        self.max_latency_ms = max(self.max_latency_ms, ms)
+        
+        if out is not None and self.output is not None:
+            self.output.put(out)
+        return out
+    
+    def get_stats(self, elapsed):
+        """Queue and latency metrics."""
+        return {
+            'queue_depth': len(self.input),
+            'queue_size': self.input.maxsize,
+            'dropped': self.input.dropped,
+            'processed': self.processed,
+            'errors': self.errors,
+            'latency_ms': self.latency_ms,
+            'max_latency_ms': self.max_latency_ms,
+            'utilization': self.busy_time / elapsed if elapsed > 0 else 0.0,
+        }
+
+
+class Pipeline:
+    """Chain of stages; the first is a source polled at a (possibly varying) interval."""
+    
+    def __init__(self, interval=5):
+        """
+        Initialize an empty pipeline.
+        
+        Args:
+            interval: Seconds between source polls, or a function returning
+                them (read again before every poll)
+        """
+        self.interval = interval
+        self.stages = []
+        self.running = False
+        self.started = None
+        self.completed = 0
+    
+    def add_stage(self, name, fn, queue_size=2):
+        """
+        Append a stage. The first stage is the source: fn is called with no
+        arguments and its result starts a new item.
+        
+        Returns:
+            self, for chaining
+        """
+        stage = Stage(name, fn, queue_size)
+        if self.stages:
+            self.stages[-1].output = stage.input
+        self.stages.append(stage)
+        return self
+    
+    def _next_interval(self):
+        try:
+            return self.interval() if callable(self.interval) else self.interval
+        except Exception as e:
+            logger.error(f"Pipeline interval error: {e}")
+            return 1
+    
+    def _source_loop(self, stage):
+        """Poll the source, then wait out the rest of the interval."""
+        while self.running:
+            start = time.monotonic()
+            stage.run_once(None)
+            
+            # Re-read the interval while waiting, so a shorter one (e.g. the
+            # alert level rising) takes effect without sitting out a long sleep
+            while self.running:
+                remaining = self._next_interval() - (time.monotonic() - start)
+                if remaining <= 0:
+                    break
+                time.sleep(min(remaining, 1.0))
+    
+    def cost(self):
+        """Average seconds of work per item, summed over all stages."""
+        return sum(stage.latency_ms or 0.0 for stage in self.stages) / 1000
+    
+    def _stage_loop(self, stage, last):
+        """Process items from the stage's queue until stopped."""
+        while self.running:
+            item = stage.input.get(timeout=1)
+            if item is None:
+                continue
+            if stage.run_once(item) is not None and last:
+                self.completed += 1
+    
+    def start(self):
+        """Start one worker thread per stage."""
+        if not self.stages:
+            raise ValueError("Pipeline has no stages")
+        
+        self.running = True
+        self.started = time.monotonic()
+        for i, stage in enumerate(self.stages):
+            if i == 0:
+                target, args = self._source_loop, (stage,)
+            else:
+                target, args = self._stage_loop, (stage, i == len(self.stages) - 1)
+            stage.thread = threading.Thread(target=target, args=args, name=f"Pipeline-{stage.name}", daemon=True)
+            stage.thread.start()
+        
+        logger.info(f"Pipeline started: {' -> '.join(s.name for s in self.stages)}")
+    
+    def stop(self, timeout=5):
+        """Stop all workers (items still queued are discarded)."""
+        self.running = False
+        for stage in self.stages:
+            stage.input.close()
+        for stage in self.stages:
+            if stage.thread is not None:
+                stage.thread.join(timeout=timeout)
+    
+    def get_status(self):
+        """Per-stage queue depth and latency, plus overall throughput."""
+        elapsed = time.monotonic() - self.started if self.started else 0.0
+        stages = {stage.name: stage.get_stats(elapsed) for stage in self.stages}
+        bottleneck = max(self.stages, key=lambda s: s.latency_ms or 0).name if self.stages else None
+        return {
+            'running': self.running,
+            'stages': stages,
+            'completed': self.completed,
+            'throughput_fps': self.completed / elapsed if elapsed > 0 else 0.0,
+            'bottleneck': bottleneck,
+        }
+
+
+def test_pipeline():
+    """Four stages with uneven costs: throughput follows the slowest one, not the sum."""
+    print("Testing pipeline...")
+    
+    costs = {'capture': 0.005, 'preprocess': 0.010, 'infer': 0.030, 'publish': 0.002}
+    published = []
+    
+    def work(name):
+        def fn(item):
+            time.sleep(costs[name])
+            return (item or 0) + 1
+        return fn
+    
+    pipeline = Pipeline(interval=0)
+    for name in ('capture', 'preprocess', 'infer'):
+        pipeline.add_stage(name, work(name))
+    pipeline.add_stage('publish', lambda item: published.append(item) or item)
+    
+    pipeline.start()
+    time.sleep(2.0)
+    status = pipeline.get_status()
+    pipeline.stop()
+    
+    for name, stats in status['stages'].items():
+        print(f"  {name:10s} depth {stats['queue_depth']}/{stats['queue_size']}  "
+              f"dropped {stats['dropped']:4d}  latency {stats['latency_ms']:.1f} ms  "
+              f"utilization {stats['utilization']:.0%}")
+    sequential = 1 / sum(costs.values())
+    print(f"  Throughput: {status['throughput_fps']:.1f} fps (sequential: {sequential:.1f} fps), "
+          f"bottleneck: {status['bottleneck']}")
+    
+    ok = status['throughput_fps'] > 1.4 * sequential and status['bottleneck'] == 'infer'
+    ok &= status['stages']['infer']['dropped'] > 0 and all(p == 3 for p in published)
+    print("Pipeline test PASSED" if ok else "Pipeline test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    test_pipeline()
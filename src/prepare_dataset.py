@@ -0,0 +1,305 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Dataset Preparation
+
+Turns a folder-per-class image collection (S-BIRD, our own labelled
+captures) into train/val/test splits ready for upload to Edge Impulse:
+
+    python3 prepare_dataset.py S-BIRD/images data/visual --size 96 --augment 3
+
+Each image is decoded and resized with exactly the code the gateway runs
+before inference (decode_jpeg at reduced DCT scale, then Preprocessor), so
+training and deployment see the same pixels. Outputs are lossless PNGs of
+that uint8 RGB tensor.
+
+The split is stratified: every class is shuffled (with a fixed seed) and
+divided by the same fractions. Augmented copies (flip, small rotation,
+brightness/contrast, sensor noise) are only made for the training split,
+from the preprocessed image, and are reproducible from the seed.
+
+Work runs on a thread pool: idle workers take the next image from a
+shared queue, and OpenCV releases the GIL while decoding, resizing and
+encoding, so throughput scales with cores. manifest.json lists every
+output file with its label, split and source.
+
+Source folder names are mapped to the detector's classes; the S-BIRD
+names are built in, others can be given with --label-map.
+"""
+
+import argparse
+import json
+import logging
+import os
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from pathlib import Path
+
+import cv2
+import numpy as np
+
+from jpeg_decode import decode_jpeg
+from preprocess import Preprocessor
+
+logger = logging.getLogger('DrainSentinel.Dataset')
+
+LABELS = ['clear', 'partial_blockage', 'full_blockage']
+SPLITS = ['train', 'val', 'test']
+IMAGE_SUFFIXES = ('.jpg', '.jpeg', '.png', '.bmp')
+
+# Source folder -> class (S-BIRD layout, and the names DATA_PREPARATION.md uses)
+DEFAULT_LABEL_MAP = {
+    'normal_images': 'clear',
+    'no_blockage': 'clear',
+    'debris_images': 'partial_blockage',
+    'blockage_images': 'full_blockage',
+    'complete_blockage': 'full_blockage',
+    **{label: label for label in LABELS},
+}
+
+
+def find_images(source, label_map):
+    """(path, label) for every image in a mapped class folder under source."""
+    images = []
+    for folder in sorted(p for p in Path(source).iterdir() if p.is_dir()):
+        label = label_map.get(folder.name)
+        if label is None:
+            logger.warning(f"Skipping unmapped folder {folder.name}")
+            continue
+        for path in sorted(folder.rglob('*')):
+            if path.suffix.lower() in IMAGE_SUFFIXES:
+                images.append((path, label))
+    return images
+
+
+def stratified_split(images, fractions=(0.7, 0.15, 0.15), seed=42):
+    """
+    Assign each image a split, with the same class balance in every split.
+    
+    Returns:
+        List of (path, label, split)
+    """
+    rng = np.random.default_rng(seed)
+    assigned = []
+    for label in sorted({label for _, label in images}):
+        paths = [path for path, l in images if l == label]
+        order = rng.permutation(len(paths))
+        # Cumulative boundaries, so rounding never loses an image
+        bounds = np.floor(np.cumsum(fractions) / sum(fractions) * len(paths) + 0.5).astype(int)
+        for rank, i in enumerate(order):
+            split = SPLITS[int(np.searchsorted(bounds, rank, side='right'))]
+            assigned.append((paths[i], label, split))
+    return assigned
+
+
+def augment(image, rng):
+    """
+    One random training variant of a preprocessed RGB uint8 image.
+    
+    Horizontal flip (p=0.5), rotation up to 15 degrees, brightness and
+    contrast up to 20%, and Gaussian noise (p=0.3).
+    """
+    if rng.random() < 0.5:
+        image = image[:, ::-1]
+    h, w = image.shape[:2]
+    matrix = cv2.getRotationMatrix2D((w / 2, h / 2), rng.uniform(-15, 15), 1.0)
+    image = cv2.warpAffine(np.ascontiguousarray(image), matrix, (w, h), borderMode=cv2.BORDER_REFLECT_101)
+    
+    contrast = rng.uniform(0.8, 1.2)
+    brightness = rng.uniform(-0.2, 0.2) * 255
+    result = image.astype(np.float32) * contrast + brightness
+    if rng.random() < 0.3:
+        result += rng.normal(0, 8, result.shape).astype(np.float32)
+    return np.clip(result, 0, 255).astype(np.uint8)
+
+
+class DatasetWriter:
+    """Preprocesses and writes images on a thread pool."""
+    
+    def __init__(self, output, size=(96, 96), augmentations=0, seed=42):
+        """
+        Args:
+            output: Output directory (split/label/ subdirectories are created)
+            size: Model input size (width, height)
+            augmentations: Augmented copies per training image
+            seed: Seed for augmentation
+        """
+        self.output = Path(output)
+        self.size = tuple(size)
+        self.augmentations = augmentations
+        self.seed = seed
+        # A Preprocessor reuses scratch buffers, so each worker has its own
+        self.local = threading.local()
+        
+        for split in SPLITS:
+            for label in LABELS:
+                (self.output / split / label).mkdir(parents=True, exist_ok=True)
+    
+    def _preprocessor(self):
+        if not hasattr(self.local, 'preprocessor'):
+            self.local.preprocessor = Preprocessor(self.size, np.uint8)
+        return self.local.preprocessor
+    
+    def process(self, index, path, label, split):
+        """
+        Decode, preprocess and write one image (and its augmentations).
+        
+        Returns:
+            Manifest entries for the written files (empty if unreadable)
+        """
+        try:
+            image = decode_jpeg(Path(path).read_bytes(), self.size)
+        except OSError as e:
+            logger.warning(f"Skipping {path}: {e}")
+            return []
+        if image is None:
+            logger.warning(f"Skipping undecodable image {path}")
+            return []
+        
+        # The same kernel (and reduced-scale decode) as inference
+        rgb = self._preprocessor()(image)
+        
+        stem = f"{index:06d}_{Path(path).stem}"
+        directory = self.output / split / label
+        entries = [self._write(directory / f"{stem}.png", rgb, path, label, split, None)]
+        if split == 'train':
+            for k in range(self.augmentations):
+                rng = np.random.default_rng([self.seed, index, k])
+                entries.append(self._write(directory / f"{stem}_aug{k}.png", augment(rgb, rng),
+                                           path, label, split, k))
+        return entries
+    
+    def _write(self, filepath, rgb, source, label, split, augmentation):
+        # PNG is lossless: the file holds exactly the tensor the model is trained on
+        if not cv2.imwrite(str(filepath), np.ascontiguousarray(rgb[..., ::-1])):
+            raise OSError(f"Failed to write {filepath}")
+        return {
+            'path': str(filepath.relative_to(self.output)),
+            'label': label,
+            'split': split,
+            'source': str(source),
+            'augmentation': augmentation,
+        }
+    
+    def run(self, assigned, workers=None):
+        """
+        Process every (path, label, split) and write manifest.json.
+        
+        Returns:
+            Manifest dictionary
+        """
+        workers = workers or os.cpu_count() or 1
+        if workers > 1:
+            # Parallelism comes from the pool; OpenCV's own threads would oversubscribe
+            cv2.setNumThreads(1)
+        
+        start = time.perf_counter()
+        with ThreadPoolExecutor(max_workers=workers) as pool:
+            futures = [pool.submit(self.process, i, path, label, split)
+                       for i, (path, label, split) in enumerate(assigned)]
+            entries = [entry for future in futures for entry in future.result()]
+        elapsed = time.perf_counter() - start
+        
+        counts = {split: {label: 0 for label in LABELS} for split in SPLITS}
+        for entry in entries:
+            counts[entry['split']][entry['label']] += 1
+        sources = len({entry['source'] for entry in entries})
+        
+        manifest = {
+            'size': list(self.size),
+            'format': 'png, RGB uint8 (the inference input tensor)',
+            'seed': self.seed,
+            'augmentations': self.augmentations,
+            'source_images': sources,
+            'skipped': len(assigned) - sources,
+            'counts': counts,
+            'files': entries,
+        }
+        with open(self.output / 'manifest.json', 'w') as f:
+            json.dump(manifest, f, indent=2)
+        
+        logger.info(f"Prepared {sources} images into {len(entries)} files in {elapsed:.1f}s "
+                    f"({sources / elapsed if elapsed else 0:.0f} images/s, {workers} workers)")
+        manifest['elapsed_s'] = elapsed
+        return manifest
+
+
+def test_prepare_dataset():
+    """Stratified splits, augmentation, and pixels identical to the detector's input."""
+    import shutil
+    import tempfile
+    
+    from ai_detector import BlockageDetector
+    
+    print("Testing dataset preparation...")
+    
+    directory = Path(tempfile.mkdtemp())
+    try:
+        source, output = directory / 'S-BIRD', directory / 'visual'
+        rng = np.random.default_rng(0)
+        y, x = np.mgrid[0:720, 0:1280]
+        folders = {'normal_images': 20, 'debris_images': 10, 'blockage_images': 10}
+        for folder, count in folders.items():
+            (source / folder).mkdir(parents=True)
+            for i in range(count):
+                base = 120 + 50 * np.sin(x / (20.0 + i)) * np.cos(y / 23.0)
+                image = np.clip(np.dstack([base, base * 0.9, base * 0.8]) + rng.normal(0, 3, (720, 1280, 3)),
+                                0, 255).astype(np.uint8)
+                cv2.imwrite(str(source / folder / f"img_{i:03d}.jpg"), image)
+        
+        assigned = stratified_split(find_images(source, DEFAULT_LABEL_MAP))
+        manifest = DatasetWriter(output, size=(224, 224), augmentations=2).run(assigned, workers=4)
+        counts = manifest['counts']
+        print(f"  {manifest['source_images']} images -> {len(manifest['files'])} files, "
+              f"{manifest['source_images'] / manifest['elapsed_s']:.0f} images/s; counts {counts}")
+        
+        ok = counts['train'] == {'clear': 42, 'partial_blockage': 21, 'full_blockage': 21}
+        ok &= counts['val'] == {'clear': 3, 'partial_blockage': 2, 'full_blockage': 2}
+        ok &= counts['test'] == {'clear': 3, 'partial_blockage': 1, 'full_blockage': 1}
+        
+        # A stored training image is exactly what the detector feeds the model
+        detector = BlockageDetector(directory / 'no-model', cache=False)
+        entry = next(e for e in manifest['files'] if e['augmentation'] is None)
+        stored = cv2.imread(str(output / entry['path']))[..., ::-1]
+        ok &= np.array_equal(stored, detector.preprocess_image(entry['source']))
+    finally:
+        shutil.rmtree(directory)
+    
+    print("Dataset preparation test PASSED" if ok else "Dataset preparation test FAILED")
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description='Prepare a labelled image dataset for training')
+    parser.add_argument('source', nargs='?', help='Directory with one folder per class (omit to self-test)')
+    parser.add_argument('output', nargs='?', default='data/visual', help='Output directory')
+    parser.add_argument('--size', type=int, default=96, help='Model input size (96 or 224)')
+    parser.add_argument('--augment', type=int, default=0, help='Augmented copies per training image')
+    parser.add_argument('--split', default='0.7,0.15,0.15', help='Train,val,test fractions')
+    parser.add_argument('--label-map', default='', help='Extra folder=class mappings, comma-separated')
+    parser.add_argument('--workers', type=int, help='Worker threads (default: all cores)')
+    parser.add_argument('--seed', type=int, default=42, help='Split and augmentation seed')
+    args = parser.parse_args()
+    
+    logging.basicConfig(level=logging.INFO)
+    if args.source is None:
+        test_prepare_dataset()
+    else:
+        label_map = dict(DEFAULT_LABEL_MAP)
+        for mapping in filter(None, args.label_map.split(',')):
+            folder, _, label = mapping.partition('=')
+            if label not in LABELS:
+                parser.error(f"Unknown class {label!r} (expected one of {LABELS})")
+            label_map[folder.strip()] = label
+        
+        fractions = [float(f) for f in args.split.split(',')]
+        if len(fractions) != 3:
+            parser.error("--split needs three fractions")
+        
+        images = find_images(args.source, label_map)
+        if not images:
+            parser.error(f"No images found in class folders under {args.source}")
+        assigned = stratified_split(images, fractions, args.seed)
+        manifest = DatasetWriter(args.output, (args.size, args.size), args.augment, args.seed).run(
+            assigned, args.workers)
+        print(json.dumps(manifest['counts'], indent=2))
+        print(f"Manifest saved to: {Path(args.output) / 'manifest.json'}")
@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Model Input Preprocessing
+
+Turns a BGR camera image into a model input tensor with two passes
+instead of the usual resize / cvtColor / astype / divide chain:
+
+1. Area resample into a reused uint8 scratch buffer. Large reductions
+   first box-filter by the integer part of the scale factor (OpenCV's
+   vectorized fast INTER_AREA path, NEON on the Pi, SSE/AVX on x86), then
+   bilinear-resample the small intermediate (less than 2x larger) to the
+   exact size. This is about twice as fast as a direct fractional
+   INTER_AREA and stays within a level or two of it.
+2. One numpy ufunc over a channel-reversed view of the scratch buffer that
+   swizzles BGR->RGB, converts and normalizes straight into the caller's
+   tensor
+
+The full-resolution frame is read exactly once and no intermediate
+full-size buffers are allocated.
+
+Output formats:
+    uint8    RGB 0-255 (Edge Impulse runner input)
+    float32  RGB 0-1
+    int8     RGB x - 128 (full-integer quantized models with scale 1/255,
+             zero point -128); computed as x ^ 0x80 on the uint8 bits
+"""
+
+import logging
+import time
+from collections import OrderedDict
+
+import cv2
+import numpy as np
+
+logger = logging.getLogger('DrainSentinel.Preprocess')
+
+SUPPORTED_DTYPES = (np.uint8, np.float32, np.int8)
+
+# Source shapes whose prefilter plan is kept (full frames plus a few ROI crops)
+PREFILTER_SHAPES = 8
+
+
+class Preprocessor:
+    """Reusable resize + swizzle + normalize for one input size and dtype."""
+    
+    def __init__(self, size, dtype=np.float32, layout='NHWC'):
+        """
+        Initialize the preprocessor.
+        
+        Args:
+            size: Model input size (width, height)
+            dtype: Output dtype, one of uint8, float32, int8
+            layout: 'NHWC' (height, width, channels) or 'NCHW'
+        """
+        dtype = np.dtype(dtype).type
+        if dtype not in SUPPORTED_DTYPES:
+            raise ValueError(f"Unsupported dtype: {dtype}")
+        if layout not in ('NHWC', 'NCHW'):
+            raise ValueError(f"Unsupported layout: {layout}")
+        
+        self.size = tuple(size)
+        self.dtype = dtype
+        self.layout = layout
+        # Not shared between threads: each user owns its own Preprocessor
+        self.scratch = np.empty((self.size[1], self.size[0], 3), dtype=np.uint8)
+        # Source shape -> (crop slices, intermediate buffer), most recent last
+        self.prefilter = OrderedDict()
+    
+    @property
+    def shape(self):
+        """Output tensor shape (without a batch dimension)."""
+        w, h = self.size
+        return (h, w, 3) if self.layout == 'NHWC' else (3, h, w)
+    
+    def allocate(self, batch=None):
+        """New output tensor, optionally with a leading batch dimension."""
+        shape = self.shape if batch is None else (batch,) + self.shape
+        return np.empty(shape, dtype=self.dtype)
+    
+    def __call__(self, image, out=None):
+        """
+        Preprocess one BGR image.
+        
+        Args:
+            image: BGR uint8 image of any size
+            out: Tensor to write into (e.g. a slice of a batch or the
+                interpreter's input buffer); allocated if None
+        
+        Returns:
+            The output tensor
+        """
+        if out is None:
+            out = self.allocate()
+        
+        # Pass 1: area resample (a plain copy if already at size)
+        if image.shape[1] == self.size[0] and image.shape[0] == self.size[1]:
+            np.copyto(self.scratch, image)
+        else:
+            small = self._box_prefilter(image)
+            # Under 2x left after the box filter: bilinear no longer aliases
+            interpolation = cv2.INTER_AREA if small is image else cv2.INTER_LINEAR
+            cv2.resize(small, self.size, dst=self.scratch, interpolation=interpolation)
+        
+        # Pass 2: BGR->RGB via a reversed view, fused with conversion
+        rgb = self.scratch[..., ::-1]
+        dst = out if self.layout == 'NHWC' else out.transpose(1, 2, 0)
+        if self.dtype is np.float32:
+            np.multiply(rgb, np.float32(1.0 / 255.0), out=dst, dtype=np.float32)
+        elif self.dtype is np.int8:
+            np.bitwise_xor(rgb, np.uint8(0x80), out=dst.view(np.uint8))
+        else:
+            np.copyto(dst, rgb)
+        
+        return out
+    
+    def _box_prefilter(self, image):
+        """Integer-factor box downsample for reductions of 2x or more."""
+        key = image.shape
+        if key in self.prefilter:
+            self.prefilter.move_to_end(key)
+        else:
+            # Shapes change with ROIs and decode scales (e.g. the dataset
+            # tool's images): keep only the recent ones
+            while len(self.prefilter) >= PREFILTER_SHAPES:
+                self.prefilter.popitem(last=False)
+            h, w = image.shape[:2]
+            fx, fy = w // self.size[0], h // self.size[1]
+            if fx < 2 and fy < 2:
+                self.prefilter[key] = None
+            else:
+                fx, fy = max(1, fx), max(1, fy)
+                w1, h1 = w // fx, h // fy
+                # Centered crop to an exact multiple so OpenCV takes its fast path
+                x0, y0 = (w - w1 * fx) // 2, (h - h1 * fy) // 2
+                self.prefilter[key] = ((slice(y0, y0 + h1 * fy), slice(x0, x0 + w1 * fx)),
+                                       np.empty((h1, w1, 3), dtype=np.uint8))
+        
+        plan = self.prefilter[key]
+        if plan is None:
+            return image
+        crop, intermediate = plan
+        h1, w1 = intermediate.shape[:2]
+        cv2.resize(image[crop], (w1, h1), dst=intermediate, interpolation=cv2.INTER_AREA)
+        return intermediate
+
+
+def preprocess_into(image, out, size=None, layout='NHWC'):
+    """
+    One-off preprocessing into a caller-provided tensor.
+    
+    Args:
+        image: BGR uint8 image
+        out: Output tensor (uint8, float32 or int8); its shape gives the size
+            unless size is passed
+        size: Model input size (width, height)
+        layout: 'NHWC' or 'NCHW'
+    
+    Returns:
+        out
+    """
+    if size is None:
+        h, w = out.shape[:2] if layout == 'NHWC' else out.shape[1:]
+        size = (w, h)
+    return Preprocessor(size, out.dtype, layout)(image, out)
+
+
+def benchmark_preprocess(iterations=200):
+    """Compare the legacy resize/cvtColor/normalize chain with Preprocessor at 1280x720."""
+    print("Benchmarking preprocessing (1280x720 BGR input)...")
+    
+    # Smooth scene with some texture, like a drain grate under water
+    y, x = np.mgrid[0:720, 0:1280]
+    base = 128 + 60 * np.sin(x / 37.0) * np.cos(y / 23.0) + np.random.normal(0, 8, (720, 1280))
+    image = np.clip(np.dstack([base, base * 0.8 + 20, 255 - base]), 0, 255).astype(np.uint8)
+    
+    def timed(fn):
+        fn()
+        start = time.perf_counter()
+        for _ in range(iterations):
+            fn()
+        return (time.perf_counter() - start) / iterations * 1000
+    
+    ok = True
+    for size in ((224, 224), (96, 96)):
+        legacy = lambda: cv2.cvtColor(cv2.resize(image, size), cv2.COLOR_BGR2RGB).astype('float32') / 255.0
+        legacy_area = lambda: cv2.cvtColor(cv2.resize(image, size, interpolation=cv2.INTER_AREA),
+                                           cv2.COLOR_BGR2RGB).astype('float32') / 255.0
+        
+        print(f"  -> {size[0]}x{size[1]}:")
+        print(f"     legacy (bilinear, 4 passes): {timed(legacy):.3f} ms")
+        print(f"     legacy (area, 4 passes):     {timed(legacy_area):.3f} ms")
+        
+        for dtype in (np.float32, np.int8, np.uint8):
+            pre = Preprocessor(size, dtype)
+            out = pre.allocate()
+            ms = timed(lambda: pre(image, out))
+            print(f"     fused -> {np.dtype(dtype).name:7s}:          {ms:.3f} ms")
+        
+        # Close to the exact area-resampled legacy chain, and the dtypes agree
+        reference = legacy_area()
+        fused = Preprocessor(size, np.float32)(image)
+        error = np.abs(fused - reference).mean() * 255
+        print(f"     mean abs difference from exact area resample: {error:.2f} levels")
+        ok &= error < 3.0
+        q = Preprocessor(size, np.int8)(image).astype(np.int16)
+        ok &= np.array_equal(q + 128, (fused * 255).round().astype(np.int16))
+        nchw = Preprocessor(size, np.float32, 'NCHW')(image)
+        ok &= np.array_equal(nchw, fused.transpose(2, 0, 1))
+    
+    # Many source shapes (a dataset of mixed sizes): plans stay bounded, results unchanged
+    pre = Preprocessor((96, 96), np.uint8)
+    for width in range(400, 1280, 40):
+        crop = image[:, :width]
+        ok &= np.array_equal(pre(crop), Preprocessor((96, 96), np.uint8)(crop))
+    ok &= len(pre.prefilter) == PREFILTER_SHAPES
+    
+    print("Preprocess test PASSED" if ok else "Preprocess test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    benchmark_preprocess()
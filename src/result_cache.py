@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Detection Result Cache
+
+Bounded LRU of model results keyed by a hash of the preprocessed input
+tensor. Identical inputs (test images run again, replays of stored
+captures, a static night scene that preprocesses to the same pixels)
+return the stored result instead of running the model.
+
+The key is a 128-bit BLAKE2b digest of the tensor bytes, its shape and
+dtype, and a model identifier, so results from a different model (or the
+mock) are never returned. Hashing a 224x224x3 tensor takes well under a
+millisecond.
+
+One process-wide cache is returned by shared_cache(), used by the live
+detector and the offline tools alike. Timings are not stored: a hit took
+no model time, so it reports none. save()/load() keep it across runs
+of the offline tools.
+"""
+
+import hashlib
+import json
+import logging
+import threading
+import time
+from collections import OrderedDict
+from pathlib import Path
+
+import numpy as np
+
+logger = logging.getLogger('DrainSentinel.Cache')
+
+# Where offline tools (test_detector, replays) keep results between runs
+OFFLINE_CACHE_FILE = Path('data/cache/detection_results.json')
+
+_shared = None
+
+# Per-run measurements, meaningless when the result is served again
+TIMING_KEYS = ('inference_time_ms', 'timing')
+
+
+class ResultCache:
+    """Thread-safe LRU of detection results keyed by input tensor content."""
+    
+    def __init__(self, max_entries=512):
+        """
+        Initialize an empty cache.
+        
+        Args:
+            max_entries: Results kept; the least recently used is evicted
+        """
+        self.max_entries = max_entries
+        self.entries = OrderedDict()
+        self.lock = threading.Lock()
+        
+        self.hits = 0
+        self.misses = 0
+        self.hash_time = 0.0
+        self.hashes = 0
+    
+    def key(self, tensor, model_id=''):
+        """Content key of a preprocessed tensor for a given model."""
+        start = time.perf_counter()
+        h = hashlib.blake2b(digest_size=16)
+        h.update(f"{model_id}|{tensor.dtype.str}|{tensor.shape}".encode())
+        h.update(np.ascontiguousarray(tensor).data)
+        digest = h.hexdigest()
+        self.hash_time += time.perf_counter() - start
+        self.hashes += 1
+        return digest
+    
+    def get(self, key):
+        """
+        Look up a result.
+        
+        Returns:
+            A copy of the stored result marked 'cached', or None on a miss
+        """
+        with self.lock:
+            result = self.entries.get(key)
+            if result is None:
+                self.misses += 1
+                return None
+            self.entries.move_to_end(key)
+            self.hits += 1
+        return {**result, 'cached': True}
+    
+    def put(self, key, result):
+        """Store a result (failed inferences are not cached)."""
+        if result is None or result.get('error'):
+            return
+        with self.lock:
+            # A copy: callers may add keys to the result they got
+            self.entries[key] = {k: v for k, v in result.items() if k not in TIMING_KEYS}
+            self.entries.move_to_end(key)
+            while len(self.entries) > self.max_entries:
+                self.entries.popitem(last=False)
+    
+    def clear(self):
+        with self.lock:
+            self.entries.clear()
+    
+    def save(self, path):
+        """Write the cached results to a JSON file."""
+        path = Path(path)
+        path.parent.mkdir(parents=True, exist_ok=True)
+        with self.lock:
+            data = {'max_entries': self.max_entries, 'entries': list(self.entries.items())}
+        tmp_path = path.with_suffix('.tmp')
+        with open(tmp_path, 'w') as f:
+            json.dump(data, f, default=float)
+        tmp_path.replace(path)
+    
+    def load(self, path):
+        """Add results saved by save() (most recent last). Missing files are ignored."""
+        try:
+            with open(path) as f:
+                data = json.load(f)
+        except FileNotFoundError:
+            return
+        except (OSError, ValueError) as e:
+            logger.warning(f"Ignoring unreadable result cache {path}: {e}")
+            return
+        for key, result in data.get('entries', []):
+            self.put(key, result)
+        logger.info(f"Loaded {len(self.entries)} cached results from {path}")
+    
+    def get_stats(self):
+        """Hit/miss metrics for the dashboard and tools."""
+        lookups = self.hits + self.misses
+        return {
+            'entries': len(self.entries),
+            'max_entries': self.max_entries,
+            'hits': self.hits,
+            'misses': self.misses,
+            'hit_rate': self.hits / lookups if lookups else 0.0,
+            'hash_us': self.hash_time / self.hashes * 1e6 if self.hashes else None,
+        }
+
+
+def shared_cache():
+    """The process-wide cache used by BlockageDetector by default."""
+    global _shared
+    if _shared is None:
+        _shared = ResultCache()
+    return _shared
+
+
+def test_result_cache():
+    """Keys, LRU eviction, model separation and persistence."""
+    import tempfile
+    
+    print("Testing result cache...")
+    
+    cache = ResultCache(max_entries=3)
+    tensors = [np.full((224, 224, 3), i, dtype=np.uint8) for i in range(4)]
+    keys = [cache.key(t, 'model-a') for t in tensors]
+    
+    ok = keys[0] == cache.key(tensors[0].copy(), 'model-a')
+    ok &= keys[0] != cache.key(tensors[0], 'model-b')
+    ok &= keys[0] != cache.key(tensors[0].astype(np.int8), 'model-a')
+    
+    for i, key in enumerate(keys[:3]):
+        cache.put(key, {'class_name': 'clear', 'confidence': 0.9, 'n': i})
+    ok &= cache.get(keys[0])['n'] == 0          # Refreshes entry 0
+    cache.put(keys[3], {'class_name': 'clear', 'confidence': 0.9, 'n': 3})
+    ok &= cache.get(keys[1]) is None            # Least recently used, evicted
+    ok &= cache.get(keys[0]) is not None and cache.get(keys[3])['cached']
+    timed = {'class_name': 'clear', 'confidence': 0.9, 'inference_time_ms': 12.5, 'timing': {'invoke': 12.5}}
+    cache.put(keys[2], timed)
+    ok &= not set(TIMING_KEYS) & set(cache.get(keys[2])) and 'timing' in timed
+    cache.put(cache.key(tensors[1]), {'error': True})
+    ok &= cache.get(cache.key(tensors[1])) is None
+    
+    with tempfile.TemporaryDirectory() as tmp:
+        path = Path(tmp) / 'results.json'
+        cache.save(path)
+        restored = ResultCache(max_entries=3)
+        restored.load(path)
+        ok &= restored.get(keys[3])['n'] == 3
+    
+    stats = cache.get_stats()
+    print(f"  {stats['hits']} hits, {stats['misses']} misses, {stats['hash_us']:.0f} us per 224x224 hash")
+    print("Result cache test PASSED" if ok else "Result cache test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    test_result_cache()
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Detection Regions of Interest
+
+The camera frames the whole street, but only the drain inlet matters for
+blockage detection. ROIs are set up in the calibration wizard and stored
+under 'rois' in config/calibration.json:
+
+    "rois": [
+        {"name": "inlet", "type": "rect", "points": [[0.40, 0.55], [0.75, 0.90]]},
+        {"name": "grate", "type": "polygon",
+         "points": [[0.1, 0.6], [0.3, 0.55], [0.35, 0.8], [0.12, 0.85]]}
+    ]
+
+Points are fractions of the frame width and height, so the same
+calibration works at any capture resolution. A rect is given by two
+opposite corners. A polygon is cropped to its bounding box and pixels
+outside it are filled with the region's mean colour, so they carry no
+signal without looking like a dark blockage.
+"""
+
+import logging
+
+import cv2
+import numpy as np
+
+logger = logging.getLogger('DrainSentinel.ROI')
+
+
+class RegionOfInterest:
+    """One detection region in normalized frame coordinates."""
+    
+    def __init__(self, name, points, kind='rect'):
+        """
+        Initialize the region.
+        
+        Args:
+            name: Region name (used in per-region results)
+            points: [[x, y], ...] as fractions of frame width/height
+            kind: 'rect' (two corners) or 'polygon' (3+ vertices)
+        """
+        points = np.clip(np.asarray(points, dtype=np.float64), 0.0, 1.0)
+        if kind == 'rect' and len(points) != 2:
+            raise ValueError(f"ROI {name}: a rect needs two corners")
+        if kind == 'polygon' and len(points) < 3:
+            raise ValueError(f"ROI {name}: a polygon needs at least three points")
+        if kind not in ('rect', 'polygon'):
+            raise ValueError(f"ROI {name}: unknown type {kind}")
+        
+        self.name = name
+        self.kind = kind
+        self.points = points
+        self._geometry = {}  # Frame (height, width) -> (slices, mask or None)
+    
+    @classmethod
+    def from_dict(cls, data, index=0):
+        return cls(data.get('name', f"roi{index}"), data['points'], data.get('type', 'rect'))
+    
+    def to_dict(self):
+        return {'name': self.name, 'type': self.kind, 'points': self.points.round(4).tolist()}
+    
+    def _geometry_for(self, height, width):
+        """Pixel crop slices and polygon mask for one frame size (cached)."""
+        key = (height, width)
+        geometry = self._geometry.get(key)
+        if geometry is None:
+            pixels = self.points * (width, height)
+            x0, y0 = np.floor(pixels.min(axis=0)).astype(int)
+            x1, y1 = np.ceil(pixels.max(axis=0)).astype(int)
+            # A region squeezed onto the right/bottom edge still gets its last pixel
+            x0, y0 = min(x0, width - 1), min(y0, height - 1)
+            x1, y1 = max(x1, x0 + 1), max(y1, y0 + 1)
+            crop = (slice(y0, y1), slice(x0, x1))
+            
+            mask = None
+            if self.kind == 'polygon':
+                mask = np.zeros((y1 - y0, x1 - x0), dtype=np.uint8)
+                polygon = np.round(pixels - (x0, y0)).astype(np.int32)
+                cv2.fillPoly(mask, [polygon], 255)
+                mask = mask == 0  # True outside the polygon
+            
+            geometry = self._geometry[key] = (crop, mask)
+        return geometry
+    
+    def crop(self, image):
+        """
+        Extract the region from a full frame.
+        
+        Returns:
+            A view of the frame for rects (no copy), or a masked copy of
+            the bounding box for polygons
+        """
+        crop, mask = self._geometry_for(*image.shape[:2])
+        region = image[crop]
+        if mask is not None:
+            region = region.copy()
+            region[mask] = cv2.mean(region, mask=(~mask).view(np.uint8))[:3]
+        return region
+    
+    def __repr__(self):
+        return f"RegionOfInterest({self.name}, {self.kind}, {len(self.points)} points)"
+
+
+def load_rois(calibration):
+    """
+    ROIs from a calibration dictionary.
+    
+    Returns:
+        List of RegionOfInterest (empty: use the whole frame)
+    """
+    rois = []
+    for i, data in enumerate((calibration or {}).get('rois', [])):
+        try:
+            rois.append(RegionOfInterest.from_dict(data, i))
+        except (KeyError, ValueError) as e:
+            logger.error(f"Ignoring invalid ROI {i}: {e}")
+    if rois:
+        logger.info(f"Detection ROIs: {', '.join(r.name for r in rois)}")
+    return rois
+
+
+def test_roi():
+    """Crop slices, coordinate rounding, edge regions and polygon fill."""
+    print("Testing regions of interest...")
+    
+    # Each pixel encodes its own coordinates: B = x, G = y
+    y, x = np.mgrid[0:200, 0:320]
+    frame = np.dstack([x % 256, y, np.zeros_like(x)]).astype(np.uint8)
+    
+    # Rect corners in either order; fractional edges round outwards
+    rect = RegionOfInterest('inlet', [[0.75, 0.9], [0.25, 0.5]])
+    region = rect.crop(frame)
+    ok = region.shape == (80, 160, 3) and region[0, 0, 0] == 80 and region[0, 0, 1] == 100
+    ok &= np.shares_memory(region, frame)  # Rects are views
+    odd = RegionOfInterest('odd', [[0.1, 0.1], [0.2, 0.2]]).crop(frame)
+    ok &= odd.shape == (20, 32, 3) and odd[0, 0, 0] == 32 and odd[-1, -1, 0] == 63
+    
+    # Regions collapsed onto the frame edge (or clipped to it) keep one pixel
+    for points in ([[1.0, 1.0], [1.2, 1.5]], [[0.0, 1.0], [0.0, 1.0]], [[1.0, 0.0], [1.0, 0.0]]):
+        edge = RegionOfInterest('edge', points).crop(frame)
+        ok &= edge.shape[:2] == (1, 1)
+    
+    # Polygon: bounding box, outside filled with the inside mean, frame untouched
+    bright = frame.copy()
+    bright[50:150, 100:200] = 200
+    triangle = RegionOfInterest('grate', [[0.3125, 0.25], [0.625, 0.25], [0.3125, 0.75]], kind='polygon')
+    region = triangle.crop(bright)
+    ok &= region.shape == (100, 100, 3) and not np.shares_memory(region, bright)
+    ok &= (region[0, 0] == 200).all() and (region[-5, -5] == 200).all()  # Outside corner filled
+    ok &= (bright[:50] == frame[:50]).all()
+    
+    # Config round trip; invalid entries are skipped
+    rois = load_rois({'rois': [triangle.to_dict(), {'name': 'bad', 'points': [[0, 0]]}, rect.to_dict()]})
+    ok &= [r.name for r in rois] == ['grate', 'inlet'] and rois[0].kind == 'polygon'
+    ok &= np.allclose(rois[1].points, rect.points)
+    
+    print("ROI test PASSED" if ok else "ROI test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    test_roi()
@@ -0,0 +1,329 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Multi-Resolution Rollups
+
+Keeps min/max/mean/last aggregates of each history series at several
+resolutions (1 s, 1 min, 15 min, 1 h). Every tier is updated incrementally
+as samples arrive, so long-range chart queries read a few thousand
+pre-aggregated buckets instead of scanning raw samples.
+"""
+
+import logging
+from pathlib import Path
+
+import numpy as np
+
+logger = logging.getLogger('DrainSentinel.Rollups')
+
+# (bucket width in seconds, buckets kept)
+ROLLUP_TIERS = [
+    (1, 86400),       # 1 day of 1 s buckets
+    (60, 43200),      # 30 days of 1 min buckets
+    (900, 35040),     # 1 year of 15 min buckets
+    (3600, 43800),    # 5 years of 1 h buckets
+]
+
+
+class RollupTier:
+    """Ring of fixed-width aggregate buckets plus the bucket being filled."""
+    
+    def __init__(self, width, capacity):
+        """
+        Initialize a rollup tier.
+        
+        Args:
+            width: Bucket width in seconds
+            capacity: Number of closed buckets kept
+        """
+        self.width = width
+        self.capacity = capacity
+        
+        self.buckets = np.zeros(capacity, dtype=np.int64)  # bucket index (ts // width)
+        self.mins = np.zeros(capacity)
+        self.maxs = np.zeros(capacity)
+        self.sums = np.zeros(capacity)
+        self.counts = np.zeros(capacity, dtype=np.int64)
+        self.lasts = np.zeros(capacity)
+        self.head = 0  # next slot to write
+        self.size = 0
+        
+        # Open bucket: [bucket, min, max, sum, count, last]
+        self.open = None
+    
+    def add(self, timestamp, value):
+        """Fold one sample into the tier (O(1))."""
+        bucket = int(timestamp // self.width)
+        o = self.open
+        
+        # Same bucket, or a late sample after a clock step: merge into open bucket
+        if o is not None and bucket <= o[0]:
+            if value < o[1]:
+                o[1] = value
+            if value > o[2]:
+                o[2] = value
+            o[3] += value
+            o[4] += 1
+            o[5] = value
+            return
+        
+        if o is not None:
+            self._close_open()
+        self.open = [bucket, value, value, value, 1, value]
+    
+    def extend(self, timestamps, values):
+        """
+        Fold a sorted batch of samples into the tier (vectorized).
+        
+        Used to rebuild tiers from raw history on startup.
+        """
+        if len(timestamps) == 0:
+            return
+        
+        buckets = (timestamps // self.width).astype(np.int64)
+        starts = np.flatnonzero(np.diff(buckets, prepend=buckets[0] - 1))
+        ends = np.append(starts[1:], len(buckets))
+        
+        group_buckets = buckets[starts]
+        mins = np.minimum.reduceat(values, starts)
+        maxs = np.maximum.reduceat(values, starts)
+        sums = np.add.reduceat(values, starts)
+        counts = ends - starts
+        lasts = values[ends - 1]
+        
+        o = self.open
+        if o is not None and group_buckets[0] <= o[0]:
+            o[1] = min(o[1], mins[0])
+            o[2] = max(o[2], maxs[0])
+            o[3] += sums[0]
+            o[4] += int(counts[0])
+            o[5] = lasts[0]
+            group_buckets, mins, maxs = group_buckets[1:], mins[1:], maxs[1:]
+            sums, counts, lasts = sums[1:], counts[1:], lasts[1:]
+            if len(group_buckets) == 0:
+                return
+        
+        if o is not None:
+            self._close_open()
+        
+        self._write(group_buckets[:-1], mins[:-1], maxs[:-1], sums[:-1], counts[:-1], lasts[:-1])
+        self.open = [int(group_buckets[-1]), float(mins[-1]), float(maxs[-1]),
+                     float(sums[-1]), int(counts[-1]), float(lasts[-1])]
+    
+    def _close_open(self):
+        """Move the open bucket into the ring (scalar fast path)."""
+        o, i = self.open, self.head
+        self.buckets[i], self.mins[i], self.maxs[i] = o[0], o[1], o[2]
+        self.sums[i], self.counts[i], self.lasts[i] = o[3], o[4], o[5]
+        self.head = (i + 1) % self.capacity
+        if self.size < self.capacity:
+            self.size += 1
+        self.open = None
+    
+    def _write(self, buckets, mins, maxs, sums, counts, lasts):
+        """Append closed buckets to the ring."""
+        n = len(buckets)
+        if n == 0:
+            return
+        if n > self.capacity:
+            buckets, mins, maxs = buckets[-self.capacity:], mins[-self.capacity:], maxs[-self.capacity:]
+            sums, counts, lasts = sums[-self.capacity:], counts[-self.capacity:], lasts[-self.capacity:]
+            n = self.capacity
+        
+        idx = (self.head + np.arange(n)) % self.capacity
+        self.buckets[idx] = buckets
+        self.mins[idx] = mins
+        self.maxs[idx] = maxs
+        self.sums[idx] = sums
+        self.counts[idx] = counts
+        self.lasts[idx] = lasts
+        
+        self.head = (self.head + n) % self.capacity
+        self.size = min(self.capacity, self.size + n)
+    
+    def _ordered(self):
+        """Ring slot indices from oldest to newest."""
+        if self.size < self.capacity:
+            return np.arange(self.size)
+        return (self.head + np.arange(self.capacity)) % self.capacity
+    
+    def oldest(self):
+        """Start time of the oldest bucket held, or None if empty."""
+        if self.size:
+            return float(self.buckets[self._ordered()[0]] * self.width)
+        if self.open is not None:
+            return float(self.open[0] * self.width)
+        return None
+    
+    def query(self, start=None, end=None):
+        """
+        Get buckets whose start time lies in [start, end].
+        
+        Returns:
+            Dictionary of numpy arrays: timestamp, min, max, mean, last, count
+        """
+        order = self._ordered()
+        buckets = self.buckets[order]
+        
+        lo = 0 if start is None else np.searchsorted(buckets, start // self.width, 'left')
+        hi = len(buckets) if end is None else np.searchsorted(buckets, end // self.width, 'right')
+        sel = order[lo:hi]
+        
+        result = {
+            'timestamp': (self.buckets[sel] * self.width).astype(np.float64),
+            'min': self.mins[sel],
+            'max': self.maxs[sel],
+            'mean': self.sums[sel] / self.counts[sel],
+            'last': self.lasts[sel],
+            'count': self.counts[sel],
+        }
+        
+        o = self.open
+        if o is not None and (start is None or o[0] >= start // self.width) \
+                and (end is None or o[0] <= end // self.width):
+            extra = {
+                'timestamp': float(o[0] * self.width), 'min': o[1], 'max': o[2],
+                'mean': o[3] / o[4], 'last': o[5], 'count': o[4],
+            }
+            result = {k: np.append(v, extra[k]) for k, v in result.items()}
+        
+        return result
+    
+    def state(self):
+        """Serializable snapshot (closed buckets oldest first, then open)."""
+        order = self._ordered()
+        return {
+            'buckets': self.buckets[order], 'mins': self.mins[order],
+            'maxs': self.maxs[order], 'sums': self.sums[order],
+            'counts': self.counts[order], 'lasts': self.lasts[order],
+            'open': np.array(self.open if self.open is not None else [], dtype=np.float64),
+        }
+    
+    def restore(self, state):
+        """Load a snapshot produced by state()."""
+        self._write(state['buckets'], state['mins'], state['maxs'],
+                    state['sums'], state['counts'], state['lasts'])
+        o = state['open']
+        if len(o):
+            self.open = [int(o[0]), float(o[1]), float(o[2]), float(o[3]), int(o[4]), float(o[5])]
+
+
+class SeriesRollups:
+    """All rollup tiers of one series."""
+    
+    def __init__(self, tiers=ROLLUP_TIERS):
+        """
+        Initialize rollups for a series.
+        
+        Args:
+            tiers: List of (bucket width seconds, capacity), finest first
+        """
+        self.tiers = [RollupTier(width, capacity) for width, capacity in tiers]
+        self.last_timestamp = None
+    
+    def add(self, timestamp, value):
+        """Fold one sample into every tier."""
+        for tier in self.tiers:
+            tier.add(timestamp, value)
+        self.last_timestamp = timestamp
+    
+    def extend(self, timestamps, values):
+        """Fold a sorted batch of samples into every tier."""
+        if len(timestamps) == 0:
+            return
+        for tier in self.tiers:
+            tier.extend(timestamps, values)
+        self.last_timestamp = float(timestamps[-1])
+    
+    def pick_tier(self, resolution, start=None):
+        """
+        Choose the coarsest tier no coarser than the requested resolution.
+        
+        If that tier does not reach back to start but a coarser one does, the
+        coarser tier is preferred over returning a truncated series.
+        
+        Returns:
+            RollupTier, or None if raw samples are needed
+        """
+        candidates = [t for t in self.tiers if t.width <= resolution]
+        if not candidates:
+            return None
+        
+        tier = candidates[-1]
+        if start is not None:
+            oldest = tier.oldest()
+            if oldest is None or oldest > start:
+                for coarser in self.tiers[len(candidates):]:
+                    coarser_oldest = coarser.oldest()
+                    if coarser_oldest is not None and coarser_oldest <= start:
+                        return coarser
+        return tier
+    
+    def save(self, path):
+        """Write all tiers to an .npz snapshot."""
+        arrays = {'last_timestamp': np.array([self.last_timestamp or 0.0])}
+        for tier in self.tiers:
+            for key, value in tier.state().items():
+                arrays[f"{tier.width}_{key}"] = value
+        np.savez(path, **arrays)
+    
+    def load(self, path):
+        """
+        Restore tiers from an .npz snapshot.
+        
+        Returns:
+            True if the snapshot was loaded
+        """
+        try:
+            with np.load(path) as data:
+                for tier in self.tiers:
+                    prefix = f"{tier.width}_"
+                    if f"{prefix}buckets" not in data:
+                        continue
+                    tier.restore({k[len(prefix):]: data[k] for k in data.files if k.startswith(prefix)})
+                self.last_timestamp = float(data['last_timestamp'][0]) or None
+            return True
+        except Exception as e:
+            logger.warning(f"Failed to load rollup snapshot {Path(path).name}: {e}")
+            return False
+
+
+def test_rollups():
+    """Compare incremental rollups against a vectorized rebuild."""
+    import time
+    
+    print("Testing rollups...")
+    
+    n = 3 * 86400
+    ts = 1_700_000_000 + np.arange(n, dtype=np.float64) + 0.25
+    values = 50 + 10 * np.sin(np.arange(n) / 3600) + np.random.normal(0, 0.3, n)
+    
+    incremental = SeriesRollups()
+    start = time.perf_counter()
+    for t, v in zip(ts, values):
+        incremental.add(t, v)
+    print(f"  Incremental: {(time.perf_counter() - start) / n * 1e6:.2f} us/sample")
+    
+    batch = SeriesRollups()
+    batch.extend(ts[:n // 2], values[:n // 2])
+    batch.extend(ts[n // 2:], values[n // 2:])
+    
+    ok = True
+    for a, b in zip(incremental.tiers, batch.tiers):
+        qa, qb = a.query(), b.query()
+        ok &= all(np.allclose(qa[k], qb[k]) for k in qa)
+    
+    start = time.perf_counter()
+    tier = incremental.pick_tier(resolution=3600, start=ts[0])
+    result = tier.query(ts[0], ts[-1])
+    print(f"  3-day query at {tier.width} s: {len(result['timestamp'])} buckets in "
+          f"{(time.perf_counter() - start) * 1000:.3f} ms")
+    
+    hourly = incremental.tiers[-1].query()
+    ok &= np.isclose(hourly['mean'][0], values[:hourly['count'][0]].mean())
+    
+    print("Rollups test PASSED" if ok else "Rollups test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO)
+    test_rollups()
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Risk-Adaptive Capture Scheduling
+
+Picks the time between camera captures (and so between inferences) from
+the current risk instead of a fixed interval:
+
+- Alert level: a base interval per level, from a slow poll when GREEN to
+  about once a second when RED.
+- Forecast: when an overflow is forecast, capture at least
+  SAMPLES_TO_CRITICAL times before it is expected.
+- Scene activity: the fraction of recent frames the change gate flagged
+  as changed. An active scene (debris moving in) halves the interval; a
+  scene that has been static for a while stretches it.
+- CPU budget: the pipeline's per-capture cost (sum of stage latencies)
+  may use at most cpu_budget of one core, which sets a floor under the
+  interval whatever the risk. On battery this is also the energy budget.
+
+Every change of interval is logged with the inputs and the rule that set
+it, and the recent decisions are kept for the dashboard, so the table
+below can be tuned from real events.
+"""
+
+import logging
+import time
+from collections import deque
+
+logger = logging.getLogger('DrainSentinel.Scheduler')
+
+# Seconds between captures at each alert level
+LEVEL_INTERVALS = {'GREEN': 30, 'YELLOW': 10, 'ORANGE': 3, 'RED': 1}
+
+# Captures wanted between now and the forecast overflow
+SAMPLES_TO_CRITICAL = 30
+
+ACTIVE_THRESHOLD = 0.2  # Fraction of recent frames changed -> scene is active
+QUIET_FACTOR = 2.0      # Interval multiplier once the scene has been static
+QUIET_AFTER = 600       # Seconds without a change before stretching
+
+
+class CaptureScheduler:
+    """Chooses the capture interval from alert level, forecast, scene activity and CPU budget."""
+    
+    def __init__(self, min_interval=1.0, max_interval=60.0, cpu_budget=0.25,
+                 level_intervals=None, history=100):
+        """
+        Initialize the scheduler.
+        
+        Args:
+            min_interval: Shortest interval (seconds)
+            max_interval: Longest interval (seconds)
+            cpu_budget: Fraction of one core detection may use on average
+            level_intervals: Override LEVEL_INTERVALS
+            history: Number of decisions kept for get_status()
+        """
+        self.min_interval = min_interval
+        self.max_interval = max_interval
+        self.cpu_budget = cpu_budget
+        self.level_intervals = dict(LEVEL_INTERVALS, **(level_intervals or {}))
+        
+        self.activity = 0.0        # EMA of "frame changed"
+        self.last_change = None
+        self.interval = None
+        self.reason = None
+        self.decisions = deque(maxlen=history)
+    
+    def record_change(self, changed, now=None):
+        """Feed one change-gate decision (True if the frame differed from the reference)."""
+        now = time.time() if now is None else now
+        self.activity = 0.8 * self.activity + 0.2 * (1.0 if changed else 0.0)
+        if changed or self.last_change is None:
+            self.last_change = now
+    
+    def next_interval(self, alert_level='GREEN', minutes_to_critical=None, cost=0.0, now=None):
+        """
+        Decide how long to wait before the next capture.
+        
+        Args:
+            alert_level: Current alert level
+            minutes_to_critical: Forecast time to the critical level, or None
+            cost: Average CPU seconds per capture (capture through publish)
+            now: Current time (seconds), defaults to time.time()
+        
+        Returns:
+            Interval in seconds
+        """
+        now = time.time() if now is None else now
+        interval = self.level_intervals.get(alert_level, self.level_intervals['GREEN'])
+        reason = f"level {alert_level}"
+        
+        if minutes_to_critical is not None and minutes_to_critical >= 0:
+            forecast = minutes_to_critical * 60 / SAMPLES_TO_CRITICAL
+            if forecast < interval:
+                interval, reason = forecast, f"overflow in {minutes_to_critical:.0f} min"
+        
+        if self.activity >= ACTIVE_THRESHOLD:
+            interval, reason = interval / 2, f"{reason}, scene active"
+        elif alert_level == 'GREEN' and self.last_change is not None and now - self.last_change >= QUIET_AFTER:
+            interval, reason = interval * QUIET_FACTOR, f"{reason}, scene quiet"
+        
+        interval = min(max(interval, self.min_interval), self.max_interval)
+        
+        floor = cost / self.cpu_budget if self.cpu_budget > 0 else 0.0
+        if floor > interval:
+            interval, reason = floor, f"CPU budget ({cost * 1000:.0f} ms per capture)"
+        
+        self._record(now, interval, reason, alert_level, minutes_to_critical, cost)
+        return interval
+    
+    def _record(self, now, interval, reason, alert_level, minutes_to_critical, cost):
+        """Log the decision when the interval moves by more than 10%."""
+        if self.interval is not None and abs(interval - self.interval) <= 0.1 * self.interval:
+            return
+        
+        decision = {
+            'time': now,
+            'interval': round(interval, 2),
+            'reason': reason,
+            'alert_level': alert_level,
+            'minutes_to_critical': minutes_to_critical,
+            'activity': round(self.activity, 3),
+            'cost_ms': round(cost * 1000, 1),
+        }
+        self.decisions.append(decision)
+        logger.info(f"Capture interval {self.interval or 0:.1f}s -> {interval:.1f}s: {reason} "
+                    f"(activity {self.activity:.2f}, cost {cost * 1000:.0f} ms)")
+        self.interval = interval
+        self.reason = reason
+    
+    def get_status(self):
+        """Current interval and recent decisions for the dashboard."""
+        return {
+            'interval': self.interval,
+            'reason': self.reason,
+            'activity': self.activity,
+            'cpu_budget': self.cpu_budget,
+            'decisions': list(self.decisions)[-10:],
+        }
+
+
+def test_scheduler():
+    """Walk through a dry spell, a storm and a CPU-starved board."""
+    print("Testing capture scheduler...")
+    
+    scheduler = CaptureScheduler(min_interval=1, max_interval=60, cpu_budget=0.25)
+    t = 0.0
+    
+    # Dry day: nothing changes for 15 minutes
+    for _ in range(30):
+        t += 30
+        scheduler.record_change(False, now=t)
+    dry = scheduler.next_interval('GREEN', None, cost=0.05, now=t)
+    
+    # Rain starts: water rising, debris moving
+    for _ in range(5):
+        scheduler.record_change(True, now=t)
+    yellow = scheduler.next_interval('YELLOW', 120, cost=0.05, now=t)
+    orange = scheduler.next_interval('ORANGE', 20, cost=0.05, now=t)
+    red = scheduler.next_interval('RED', 2, cost=0.05, now=t)
+    
+    # Slow board: 600 ms per capture caps RED at 2.4 s
+    starved = scheduler.next_interval('RED', 2, cost=0.6, now=t)
+    
+    print(f"  Dry GREEN: {dry:.1f}s, YELLOW: {yellow:.1f}s, ORANGE: {orange:.1f}s, "
+          f"RED: {red:.1f}s, RED on a slow board: {starved:.1f}s")
+    for decision in scheduler.get_status()['decisions']:
+        print(f"    {decision['interval']:5.1f}s  {decision['reason']}")
+    
+    ok = dry == 60 and yellow == 5 and orange < 3 and red == 1 and abs(starved - 2.4) < 1e-9
+    print("Scheduler test PASSED" if ok else "Scheduler test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    test_scheduler()
@@ -0,0 +1,212 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Live MJPEG Streaming
+
+One encoder thread turns each broadcast camera frame into a ready-to-send
+multipart chunk per quality tier. Every /video_feed client of that tier
+is served the same bytes object, so encode CPU depends on the number of
+active tiers, not the number of viewers. A client that can't keep up
+simply gets the newest chunk on its next write; nothing queues per client.
+"""
+
+import logging
+import threading
+import time
+
+import cv2
+
+logger = logging.getLogger('DrainSentinel.Streaming')
+
+# name -> (output size (width, height) or None for full resolution, JPEG quality)
+STREAM_TIERS = {
+    'low': ((320, 240), 50),
+    'medium': ((640, 480), 70),
+    'high': (None, 85),
+}
+
+DEFAULT_TIER = 'medium'
+
+
+class StreamTier:
+    """Latest encoded chunk for one quality tier."""
+    
+    def __init__(self, name, size, quality):
+        self.name = name
+        self.size = size
+        self.quality = quality
+        self.chunk = None
+        self.sequence = 0
+        self.clients = 0
+        self.encodes = 0
+        self.encode_time = 0.0
+        self.served = 0
+
+
+class MJPEGStreamer:
+    """Encode-once MJPEG fan-out for any number of viewers."""
+    
+    def __init__(self, camera, tiers=STREAM_TIERS):
+        """
+        Initialize the streamer. The encoder thread starts with the first client.
+        
+        Args:
+            camera: Camera (or anything with wait_frame(after, timeout))
+            tiers: Quality tier definitions, see STREAM_TIERS
+        """
+        self.camera = camera
+        self.tiers = {name: StreamTier(name, size, quality) for name, (size, quality) in tiers.items()}
+        
+        # Guards client counts; notified on every new chunk and client change
+        self.updated = threading.Condition()
+        self.thread = None
+        self.running = True
+    
+    def _encode_loop(self):
+        """Encode each new frame once for every tier that has viewers."""
+        sequence = 0
+        while self.running:
+            with self.updated:
+                self.updated.wait_for(lambda: not self.running
+                                      or any(t.clients for t in self.tiers.values()))
+                active = [t for t in self.tiers.values() if t.clients]
+            if not active:
+                continue
+            
+            sequence, frame = self.camera.wait_frame(sequence)
+            if frame is None:
+                continue
+            
+            resized = {}  # Tiers with the same output size share one resize
+            for tier in active:
+                start = time.perf_counter()
+                # MJPEG frames decode at reduced scale for the smaller tiers
+                image = frame.image if tier.size is None else frame.image_for(tier.size)
+                if tier.size is not None and (image.shape[1], image.shape[0]) != tier.size:
+                    if tier.size not in resized:
+                        resized[tier.size] = cv2.resize(image, tier.size, interpolation=cv2.INTER_AREA)
+                    image = resized[tier.size]
+                
+                ok, jpeg = cv2.imencode('.jpg', image, [cv2.IMWRITE_JPEG_QUALITY, tier.quality])
+                if not ok:
+                    logger.error(f"Failed to encode {tier.name} stream frame")
+                    continue
+                
+                data = jpeg.tobytes()
+                chunk = (b'--frame\r\nContent-Type: image/jpeg\r\nContent-Length: '
+                         + str(len(data)).encode() + b'\r\n\r\n' + data + b'\r\n')
+                tier.encode_time += time.perf_counter() - start
+                tier.encodes += 1
+                
+                with self.updated:
+                    tier.chunk = chunk
+                    tier.sequence = sequence
+                    self.updated.notify_all()
+    
+    def stream(self, tier_name=DEFAULT_TIER, timeout=5.0):
+        """
+        Generator of multipart chunks for one client.
+        
+        Args:
+            tier_name: Quality tier (unknown names fall back to the default)
+            timeout: Seconds without a new frame before the stream ends
+        """
+        tier = self.tiers.get(tier_name) or self.tiers[DEFAULT_TIER]
+        
+        with self.updated:
+            tier.clients += 1
+            if self.thread is None:
+                self.thread = threading.Thread(target=self._encode_loop, name='StreamEncoder', daemon=True)
+                self.thread.start()
+            self.updated.notify_all()
+        logger.info(f"Stream client connected ({tier.name}, {tier.clients} on tier)")
+        
+        try:
+            sent = 0
+            while self.running:
+                with self.updated:
+                    if not self.updated.wait_for(lambda: tier.sequence > sent or not self.running, timeout):
+                        break
+                    sent, chunk = tier.sequence, tier.chunk
+                if chunk is not None:
+                    tier.served += 1
+                    yield chunk
+        finally:
+            with self.updated:
+                tier.clients -= 1
+            logger.info(f"Stream client disconnected ({tier.name}, {tier.clients} on tier)")
+    
+    def get_stats(self):
+        """Per-tier client and encode statistics."""
+        return {
+            name: {
+                'clients': t.clients,
+                'encodes': t.encodes,
+                'served': t.served,
+                'encode_ms': t.encode_time / t.encodes * 1000 if t.encodes else None,
+            }
+            for name, t in self.tiers.items()
+        }
+    
+    def close(self):
+        """Stop the encoder and end all client streams."""
+        self.running = False
+        with self.updated:
+            self.updated.notify_all()
+        if self.thread is not None:
+            self.thread.join(timeout=5)
+
+
+def test_streaming():
+    """Serve 1 and then 10 clients and check the encode count stays flat."""
+    import numpy as np
+    from frame import Frame, FrameBroadcaster
+    
+    print("Testing MJPEG streaming...")
+    
+    class SyntheticCamera:
+        def __init__(self):
+            self.sequence = 0
+            self.broadcaster = FrameBroadcaster(self._read, max_fps=30)
+        
+        def _read(self):
+            self.sequence += 1
+            image = np.random.randint(0, 255, (720, 1280, 3), dtype=np.uint8)
+            return Frame(image, sequence=self.sequence)
+        
+        def wait_frame(self, after=0, timeout=1.0):
+            return self.broadcaster.wait(after, timeout)
+    
+    camera = SyntheticCamera()
+    ok = True
+    
+    for clients in (1, 10):
+        streamer = MJPEGStreamer(camera)
+        received = [0] * clients
+        
+        def viewer(i, slow):
+            for _ in streamer.stream('medium'):
+                received[i] += 1
+                if slow:
+                    time.sleep(0.2)  # A slow link: should skip frames, not queue them
+        
+        threads = [threading.Thread(target=viewer, args=(i, i == 0), daemon=True) for i in range(clients)]
+        for t in threads:
+            t.start()
+        time.sleep(2.0)
+        streamer.close()
+        for t in threads:
+            t.join(timeout=2)
+        
+        stats = streamer.get_stats()['medium']
+        print(f"  {clients:2d} clients: {stats['encodes']} encodes, {stats['served']} chunks served, "
+              f"{stats['encode_ms']:.1f} ms/encode, slow client got {received[0]}")
+        if clients == 10:
+            ok &= stats['served'] > 5 * stats['encodes'] and received[0] < max(received[1:])
+    
+    camera.broadcaster.close()
+    print("Streaming test PASSED" if ok else "Streaming test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.INFO)
+    test_streaming()
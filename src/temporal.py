@@ -0,0 +1,199 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: Temporal Blockage Filter
+
+Single frames are noisy evidence: a pedestrian crossing the grate or a
+passing shadow can score as a blockage for one capture. This filter keeps
+an exponential moving average of the class scores per camera and only
+changes the reported state with hysteresis:
+
+- clear -> blocked when the smoothed blockage probability
+  (partial + full) reaches enter_threshold
+- blocked -> clear when it falls to exit_threshold
+
+The average uses a time constant in seconds rather than a per-frame
+weight, so the same evidence takes the same time to accumulate whatever
+the capture interval: at a slow rate each frame simply counts for more.
+No single frame counts for more than max_weight, though, so even at the
+slowest rate a blockage needs two agreeing captures and a lone outlier
+is never enough. Confident frames move the average faster than
+borderline ones.
+"""
+
+import logging
+import math
+import time
+
+logger = logging.getLogger('DrainSentinel.Temporal')
+
+LABELS = ['clear', 'partial_blockage', 'full_blockage']
+BLOCKED = ('partial_blockage', 'full_blockage')
+
+
+def class_scores(result):
+    """Class probabilities from a detection result (one-hot by confidence if it has none)."""
+    scores = result.get('all_scores') or {}
+    if all(label in scores for label in LABELS):
+        return {label: float(scores[label]) for label in LABELS}
+    
+    # SimpleBlockageDetector reports features, not class scores
+    name = result.get('class_name')
+    confidence = float(result.get('confidence', 0))
+    if name not in LABELS:
+        return None
+    rest = (1 - confidence) / (len(LABELS) - 1)
+    return {label: confidence if label == name else rest for label in LABELS}
+
+
+class BlockageFilter:
+    """EMA of class scores with enter/exit hysteresis on the blocked state."""
+    
+    def __init__(self, time_constant=15.0, enter_threshold=0.6, exit_threshold=0.4,
+                 max_weight=0.5, name='camera'):
+        """
+        Initialize the filter.
+        
+        Args:
+            time_constant: EMA time constant (seconds); evidence older than
+                this has about a third of its weight left
+            enter_threshold: Smoothed blockage probability to report blocked
+            exit_threshold: Smoothed blockage probability to report clear again
+            max_weight: Largest share of the average one frame can replace;
+                below enter_threshold, one frame can't raise an alarm alone
+            name: Camera name for log messages
+        """
+        if exit_threshold > enter_threshold:
+            raise ValueError("exit_threshold must not exceed enter_threshold")
+        
+        self.time_constant = time_constant
+        self.enter_threshold = enter_threshold
+        self.exit_threshold = exit_threshold
+        self.max_weight = max_weight
+        self.name = name
+        
+        # Start from "clear" so the first odd frame after boot isn't an alarm
+        self.scores = {label: 1.0 if label == 'clear' else 0.0 for label in LABELS}
+        self.last_time = None
+        self.blocked = False
+        self.updates = 0
+        self.transitions = 0
+    
+    @property
+    def blocked_probability(self):
+        return sum(self.scores[label] for label in BLOCKED)
+    
+    def update(self, result, now=None):
+        """
+        Add one detection result.
+        
+        Args:
+            result: Detection result (class_name, confidence, all_scores)
+            now: Capture time (seconds), defaults to time.time()
+        
+        Returns:
+            Smoothed state (see get_state)
+        """
+        now = time.time() if now is None else now
+        scores = class_scores(result) if result and not result.get('error') else None
+        if scores is None:
+            return self.get_state()
+        
+        if self.last_time is None:
+            weight = self.max_weight
+        else:
+            weight = 1 - math.exp(-max(now - self.last_time, 0.0) / self.time_constant)
+            weight = min(weight, self.max_weight)
+        self.last_time = now
+        self.updates += 1
+        
+        for label in LABELS:
+            self.scores[label] += weight * (scores[label] - self.scores[label])
+        
+        p = self.blocked_probability
+        if not self.blocked and p >= self.enter_threshold:
+            self.blocked = True
+        elif self.blocked and p <= self.exit_threshold:
+            self.blocked = False
+        else:
+            return self.get_state()
+        
+        self.transitions += 1
+        logger.info(f"{self.name}: blockage {'confirmed' if self.blocked else 'cleared'} "
+                    f"(smoothed probability {p:.2f})")
+        return self.get_state()
+    
+    def get_state(self):
+        """
+        Current smoothed decision.
+        
+        Returns:
+            Dictionary with blocked, class_name, confidence (of the reported
+            state) and the smoothed scores
+        """
+        if self.blocked:
+            class_name = max(BLOCKED, key=self.scores.get)
+            confidence = self.blocked_probability
+        else:
+            class_name = 'clear'
+            confidence = self.scores['clear']
+        return {
+            'blocked': self.blocked,
+            'class_name': class_name,
+            'confidence': confidence,
+            'scores': dict(self.scores),
+        }
+    
+    def get_stats(self):
+        return {
+            'blocked_probability': self.blocked_probability,
+            'updates': self.updates,
+            'transitions': self.transitions,
+            'time_constant': self.time_constant,
+        }
+
+
+def test_temporal():
+    """A pedestrian, a real blockage at two capture rates, and its clearing."""
+    print("Testing temporal blockage filter...")
+    
+    def result(name, confidence):
+        rest = (1 - confidence) / 2
+        return {'class_name': name, 'confidence': confidence,
+                'all_scores': {label: confidence if label == name else rest for label in LABELS}}
+    
+    ok = True
+    for interval in (5, 15):
+        f = BlockageFilter(time_constant=15, enter_threshold=0.6, exit_threshold=0.4)
+        t = 0.0
+        
+        # Clear scene with one frame of a pedestrian over the grate
+        states = []
+        for i in range(20):
+            t += interval
+            states.append(f.update(result('partial_blockage' if i == 10 else 'clear', 0.85), t)['blocked'])
+        single_frame_alarm = any(states)
+        
+        # Bag lands on the grate
+        start = t
+        while not f.blocked:
+            t += interval
+            f.update(result('full_blockage', 0.9), t)
+        confirm = t - start
+        
+        # Removed again
+        start = t
+        while f.blocked:
+            t += interval
+            f.update(result('clear', 0.9), t)
+        clear = t - start
+        
+        print(f"  Every {interval:2d}s: single-frame alarm {single_frame_alarm}, "
+              f"blockage confirmed after {confirm:.0f}s, cleared after {clear:.0f}s")
+        ok &= not single_frame_alarm and confirm <= 30 and clear <= 30
+    
+    print("Temporal filter test PASSED" if ok else "Temporal filter test FAILED")
+
+
+if __name__ == '__main__':
+    logging.basicConfig(level=logging.DEBUG)
+    test_temporal()
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: In-Process TFLite Runner
+
+Runs the exported Edge Impulse model (the TensorFlow Lite flatbuffer from
+"Deployment -> TensorFlow Lite") inside the DrainSentinel process.
+
+The .eim runner starts the model as a separate process and sends every
+frame's features over a Unix socket as JSON text, 150k numbers per 224x224
+frame. Here the preprocessed tensor is copied straight into the
+interpreter's input buffer, so classification costs one memcpy plus the
+model itself. Per-stage latency is recorded so the remaining cost is
+visible.
+
+Uses whichever interpreter is installed: ai_edge_litert (LiteRT),
+tflite_runtime, or the full tensorflow package.
+"""
+
+import logging
+import time
+from pathlib import Path
+
+import numpy as np
+
+logger = logging.getLogger('DrainSentinel.TFLite')
+
+try:
+    from ai_edge_litert.interpreter import Interpreter
+    TFLITE_AVAILABLE = True
+except ImportError:
+    try:
+        from tflite_runtime.interpreter import Interpreter
+        TFLITE_AVAILABLE = True
+    except ImportError:
+        try:
+            from tensorflow.lite import Interpreter
+            TFLITE_AVAILABLE = True
+        except ImportError:
+            Interpreter = None
+            TFLITE_AVAILABLE = False
+
+STAGES = ('set_input', 'invoke', 'output')
+
+
+class TFLiteRunner:
+    """Image classifier backed by a TFLite interpreter in this process."""
+    
+    def __init__(self, model_path, labels, num_threads=4):
+        """
+        Load the model.
+        
+        Args:
+            model_path: Path to the .tflite / .lite file
+            labels: Class labels in model output order
+            num_threads: Interpreter CPU threads
+        """
+        if not TFLITE_AVAILABLE:
+            raise RuntimeError("No TFLite interpreter installed "
+                               "(pip3 install ai-edge-litert or tflite-runtime)")
+        
+        self.model_path = Path(model_path)
+        self.interpreter = Interpreter(model_path=str(self.model_path), num_threads=num_threads)
+        self.interpreter.allocate_tensors()
+        
+        inp = self.interpreter.get_input_details()[0]
+        out = self.interpreter.get_output_details()[0]
+        self.input_index = inp['index']
+        self.output_index = out['index']
+        self.input_dtype = np.dtype(inp['dtype']).type
+        self.input_quant = inp['quantization']    # (scale, zero_point); (0, 0) if float
+        self.output_quant = out['quantization']
+        self.batch_size = int(inp['shape'][0])
+        
+        _, height, width, channels = inp['shape']
+        if channels != 3:
+            raise ValueError(f"Expected an RGB model, input shape is {inp['shape'].tolist()}")
+        self.input_size = (int(width), int(height))
+        
+        self.labels = list(labels)
+        if out['shape'][-1] != len(self.labels):
+            raise ValueError(f"Model has {out['shape'][-1]} outputs for {len(self.labels)} labels")
+        
+        self.runs = 0
+        self.totals = dict.fromkeys(STAGES, 0.0)
+        
+        logger.info(f"TFLite model loaded: {self.model_path.name}, input {self.input_size} "
+                    f"{self.input_dtype.__name__}, quantization {self.input_quant}")
+    
+    @property
+    def preprocess_dtype(self):
+        """
+        Tensor dtype the preprocessor should produce for this model.
+        
+        int8 models quantized with scale 1/255 and zero point -128 take the
+        preprocessor's x - 128 output directly; uint8 models with scale
+        1/255 and zero point 0 take raw pixels. Anything else is fed float
+        0-1 and quantized in set_input.
+        """
+        scale, zero_point = self.input_quant
+        if self.input_dtype is np.float32:
+            return np.float32
+        if abs(scale * 255 - 1) < 1e-3:
+            if self.input_dtype is np.int8 and zero_point == -128:
+                return np.int8
+            if self.input_dtype is np.uint8 and zero_point == 0:
+                return np.uint8
+        return np.float32
+    
+    def _set_batch(self, batch):
+        """Resize the input for a different batch size (if the model allows it)."""
+        if batch == self.batch_size:
+            return
+        shape = [batch, self.input_size[1], self.input_size[0], 3]
+        self.interpreter.resize_tensor_input(self.input_index, shape)
+        self.interpreter.allocate_tensors()
+        self.batch_size = batch
+    
+    def classify(self, tensor):
+        """
+        Classify one image or a batch.
+        
+        Args:
+            tensor: (H, W, 3) or (N, H, W, 3) array in preprocess_dtype
+        
+        Returns:
+            (list of {label: score} per image, {stage: ms} timing)
+        """
+        timing = {}
+        start = time.perf_counter()
+        
+        if tensor.ndim == 3:
+            tensor = tensor[None]
+        if tensor.dtype != self.input_dtype:
+            # Float 0-1 into a quantized model with non-standard parameters
+            scale, zero_point = self.input_quant
+            info = np.iinfo(self.input_dtype)
+            tensor = np.clip(np.round(tensor / scale + zero_point), info.min, info.max).astype(self.input_dtype)
+        self._set_batch(len(tensor))
+        self.interpreter.set_tensor(self.input_index, tensor)
+        timing['set_input'] = time.perf_counter() - start
+        
+        start = time.perf_counter()
+        self.interpreter.invoke()
+        timing['invoke'] = time.perf_counter() - start
+        
+        start = time.perf_counter()
+        output = self.interpreter.get_tensor(self.output_index)
+        if self.output_quant[0]:
+            scale, zero_point = self.output_quant
+            output = (output.astype(np.float32) - zero_point) * scale
+        scores = [dict(zip(self.labels, row.tolist())) for row in output]
+        timing['output'] = time.perf_counter() - start
+        
+        self.runs += 1
+        for stage in STAGES:
+            self.totals[stage] += timing[stage]
+        return scores, {stage: t * 1000 for stage, t in timing.items()}
+    
+    def get_stats(self):
+        """Mean per-stage latency in ms."""
+        return {
+            'runs': self.runs,
+            **{f"{stage}_ms": self.totals[stage] / self.runs * 1000 if self.runs else None
+               for stage in STAGES},
+        }
+
+
+def test_tflite(model_path='models/drain_blockage.tflite'):
+    """Load a model, classify random input, and report stage latency."""
+    from preprocess import Preprocessor
+    
+    print(f"Testing TFLite runner with {model_path}...")
+    
+    if not TFLITE_AVAILABLE:
+        print("TFLite test SKIPPED: no interpreter installed")
+        return
+    if not Path(model_path).exists():
+        print(f"TFLite test SKIPPED: {model_path} not found")
+        return
+    
+    runner = TFLiteRunner(model_path, ['clear', 'partial_blockage', 'full_blockage'])
+    pre = Preprocessor(runner.input_size, runner.preprocess_dtype)
+    image = np.random.randint(0, 255, (720, 1280, 3), dtype=np.uint8)
+    
+    for _ in range(20):
+        start = time.perf_counter()
+        tensor = pre(image)
+        preprocess_ms = (time.perf_counter() - start) * 1000
+        scores, timing = runner.classify(tensor)
+    
+    print(f"  Scores: {scores[0]}")
+    print(f"  Last run: preprocess {preprocess_ms:.2f} ms, "
+          + ", ".join(f"{k} {v:.2f} ms" for k, v in timing.items()))
+    print(f"  Mean: {runner.get_stats()}")
+    
+    ok = abs(sum(scores[0].values()) - 1.0) < 0.05
+    print("TFLite test PASSED" if ok else "TFLite test FAILED")
+
+
+if __name__ == '__main__':
+    import sys
+    logging.basicConfig(level=logging.DEBUG)
+    test_tflite(*sys.argv[1:2])
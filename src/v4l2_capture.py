@@ -0,0 +1,434 @@
+#!/usr/bin/env python3
+"""
+DrainSentinel: V4L2 Capture Backend
+
+Direct Video4Linux2 capture with mmap'd driver buffers, used by Camera on
+Linux instead of cv2.VideoCapture:
+
+- Selectable MJPEG or YUYV pixel format
+- Always-latest-frame reads: every buffer the driver has filled since the
+  last read is dequeued and the stale ones are handed straight back, so an
+  idle period never leaves old frames queued in front of the current one
+- Per-frame capture timestamps taken from the driver, not from when
+  Python got around to reading the frame
+
+The ioctl structures are declared with ctypes using native C types, so the
+same code works on 32-bit and 64-bit ARM boards.
+
+Test against the virtual driver:
+    sudo modprobe vivid
+    python3 v4l2_capture.py /dev/video0 YUYV
+"""
+
+import ctypes
+import errno
+import fcntl
+import logging
+import mmap
+import os
+import select
+import time
+
+import cv2
+import numpy as np
+
+from jpeg_decode import decode_jpeg, ensure_huffman_tables
+
+logger = logging.getLogger('DrainSentinel.V4L2')
+
+
+# --- ioctl encoding (asm-generic/ioctl.h) ---
+
+_IOC_WRITE = 1
+_IOC_READ = 2
+
+
+def _IOC(direction, nr, size):
+    return (direction << 30) | (size << 16) | (ord('V') << 8) | nr
+
+
+def _IOR(nr, struct):
+    return _IOC(_IOC_READ, nr, ctypes.sizeof(struct))
+
+
+def _IOW(nr, struct):
+    return _IOC(_IOC_WRITE, nr, ctypes.sizeof(struct))
+
+
+def _IOWR(nr, struct):
+    return _IOC(_IOC_READ | _IOC_WRITE, nr, ctypes.sizeof(struct))
+
+
+def fourcc(code):
+    """Pixel format code from a 4-character string, e.g. 'MJPG'."""
+    return ord(code[0]) | (ord(code[1]) << 8) | (ord(code[2]) << 16) | (ord(code[3]) << 24)
+
+
+# --- videodev2.h structures ---
+
+class v4l2_capability(ctypes.Structure):
+    _fields_ = [
+        ('driver', ctypes.c_char * 16),
+        ('card', ctypes.c_char * 32),
+        ('bus_info', ctypes.c_char * 32),
+        ('version', ctypes.c_uint32),
+        ('capabilities', ctypes.c_uint32),
+        ('device_caps', ctypes.c_uint32),
+        ('reserved', ctypes.c_uint32 * 3),
+    ]
+
+
+class v4l2_pix_format(ctypes.Structure):
+    _fields_ = [
+        ('width', ctypes.c_uint32),
+        ('height', ctypes.c_uint32),
+        ('pixelformat', ctypes.c_uint32),
+        ('field', ctypes.c_uint32),
+        ('bytesperline', ctypes.c_uint32),
+        ('sizeimage', ctypes.c_uint32),
+        ('colorspace', ctypes.c_uint32),
+        ('priv', ctypes.c_uint32),
+        ('flags', ctypes.c_uint32),
+        ('ycbcr_enc', ctypes.c_uint32),
+        ('quantization', ctypes.c_uint32),
+        ('xfer_func', ctypes.c_uint32),
+    ]
+
+
+class _v4l2_format_union(ctypes.Union):
+    _fields_ = [
+        ('pix', v4l2_pix_format),
+        ('raw_data', ctypes.c_uint8 * 200),
+        ('_align', ctypes.c_void_p),  # v4l2_window holds pointers
+    ]
+
+
+class v4l2_format(ctypes.Structure):
+    _fields_ = [
+        ('type', ctypes.c_uint32),
+        ('fmt', _v4l2_format_union),
+    ]
+
+
+class v4l2_requestbuffers(ctypes.Structure):
+    _fields_ = [
+        ('count', ctypes.c_uint32),
+        ('type', ctypes.c_uint32),
+        ('memory', ctypes.c_uint32),
+        ('capabilities', ctypes.c_uint32),
+        ('flags', ctypes.c_uint8),
+        ('reserved', ctypes.c_uint8 * 3),
+    ]
+
+
+class timeval(ctypes.Structure):
+    _fields_ = [
+        ('tv_sec', ctypes.c_long),
+        ('tv_usec', ctypes.c_long),
+    ]
+
+
+class v4l2_timecode(ctypes.Structure):
+    _fields_ = [
+        ('type', ctypes.c_uint32),
+        ('flags', ctypes.c_uint32),
+        ('frames', ctypes.c_uint8),
+        ('seconds', ctypes.c_uint8),
+        ('minutes', ctypes.c_uint8),
+        ('hours', ctypes.c_uint8),
+        ('userbits', ctypes.c_uint8 * 4),
+    ]
+
+
+class _v4l2_buffer_m(ctypes.Union):
+    _fields_ = [
+        ('offset', ctypes.c_uint32),
+        ('userptr', ctypes.c_ulong),
+        ('planes', ctypes.c_void_p),
+        ('fd', ctypes.c_int32),
+    ]
+
+
+class v4l2_buffer(ctypes.Structure):
+    _fields_ = [
+        ('index', ctypes.c_uint32),
+        ('type', ctypes.c_uint32),
+        ('bytesused', ctypes.c_uint32),
+        ('flags', ctypes.c_uint32),
+        ('field', ctypes.c_uint32),
+        ('timestamp', timeval),
+        ('timecode', v4l2_timecode),
+        ('sequence', ctypes.c_uint32),
+        ('memory', ctypes.c_uint32),
+        ('m', _v4l2_buffer_m),
+        ('length', ctypes.c_uint32),
+        ('reserved2', ctypes.c_uint32),
+        ('request_fd', ctypes.c_int32),
+    ]
+
+
+VIDIOC_QUERYCAP = _IOR(0, v4l2_capability)
+VIDIOC_S_FMT = _IOWR(5, v4l2_format)
+VIDIOC_REQBUFS = _IOWR(8, v4l2_requestbuffers)
+VIDIOC_QUERYBUF = _IOWR(9, v4l2_buffer)
+VIDIOC_QBUF = _IOWR(15, v4l2_buffer)
+VIDIOC_DQBUF = _IOWR(17, v4l2_buffer)
+VIDIOC_STREAMON = _IOW(18, ctypes.c_int)
+VIDIOC_STREAMOFF = _IOW(19, ctypes.c_int)
+
+V4L2_BUF_TYPE_VIDEO_CAPTURE = 1
+V4L2_MEMORY_MMAP = 1
+V4L2_FIELD_ANY = 0
+V4L2_CAP_VIDEO_CAPTURE = 0x00000001
+V4L2_CAP_STREAMING = 0x04000000
+V4L2_CAP_DEVICE_CAPS = 0x80000000
+V4L2_BUF_FLAG_TIMESTAMP_MASK = 0x0000e000
+V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC = 0x00002000
+
+PIXEL_FORMATS = {'MJPG': fourcc('MJPG'), 'YUYV': fourcc('YUYV')}
+
+
+class V4L2Capture:
+    """Memory-mapped V4L2 capture device with always-latest-frame reads."""
+    
+    def __init__(self, device='/dev/video0', resolution=(1280, 720), pixel_format='MJPG',
+                 num_buffers=4):
+        """
+        Open and start streaming from a V4L2 device.
+        
+        Args:
+            device: Device path, or an integer index (N -> /dev/videoN)
+            resolution: Requested (width, height); the driver may adjust it
+            pixel_format: 'MJPG' or 'YUYV'
+            num_buffers: Driver buffers to mmap
+        """
+        if isinstance(device, int):
+            device = f"/dev/video{device}"
+        if pixel_format not in PIXEL_FORMATS:
+            raise ValueError(f"Unsupported pixel format: {pixel_format}")
+        
+        self.device = device
+        self.pixel_format = pixel_format
+        self.fd = None
+        self.buffers = []
+        self.streaming = False
+        self.sequence = 0
+        self.last_timestamp = None
+        self.dropped = 0  # Stale frames skipped to return the latest one
+        
+        self.fd = os.open(device, os.O_RDWR | os.O_NONBLOCK)
+        try:
+            self._query_caps()
+            self._set_format(resolution)
+            self._init_buffers(num_buffers)
+            self._start()
+        except Exception:
+            self.release()
+            raise
+        
+        logger.info(f"V4L2 capture on {device}: {self.width}x{self.height} {pixel_format}, "
+                    f"{len(self.buffers)} mmap buffers")
+    
+    def _ioctl(self, request, arg):
+        fcntl.ioctl(self.fd, request, arg)
+    
+    def _query_caps(self):
+        cap = v4l2_capability()
+        self._ioctl(VIDIOC_QUERYCAP, cap)
+        caps = cap.device_caps if cap.capabilities & V4L2_CAP_DEVICE_CAPS else cap.capabilities
+        if not caps & V4L2_CAP_VIDEO_CAPTURE:
+            raise RuntimeError(f"{self.device} is not a video capture device")
+        if not caps & V4L2_CAP_STREAMING:
+            raise RuntimeError(f"{self.device} does not support streaming I/O")
+        self.card = cap.card.decode(errors='replace')
+    
+    def _set_format(self, resolution):
+        fmt = v4l2_format()
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE
+        fmt.fmt.pix.width = resolution[0]
+        fmt.fmt.pix.height = resolution[1]
+        fmt.fmt.pix.pixelformat = PIXEL_FORMATS[self.pixel_format]
+        fmt.fmt.pix.field = V4L2_FIELD_ANY
+        self._ioctl(VIDIOC_S_FMT, fmt)
+        
+        if fmt.fmt.pix.pixelformat != PIXEL_FORMATS[self.pixel_format]:
+            raise RuntimeError(f"{self.device} does not support {self.pixel_format}")
+        
+        self.width = fmt.fmt.pix.width
+        self.height = fmt.fmt.pix.height
+        self.bytesperline = fmt.fmt.pix.bytesperline
+    
+    def _init_buffers(self, count):
+        req = v4l2_requestbuffers()
+        req.count = count
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE
+        req.memory = V4L2_MEMORY_MMAP
+        self._ioctl(VIDIOC_REQBUFS, req)
+        if req.count < 2:
+            raise RuntimeError(f"Insufficient buffer memory on {self.device}")
+        
+        for index in range(req.count):
+            buf = v4l2_buffer()
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE
+            buf.memory = V4L2_MEMORY_MMAP
+            buf.index = index
+            self._ioctl(VIDIOC_QUERYBUF, buf)
+            self.buffers.append(mmap.mmap(self.fd, buf.length, mmap.MAP_SHARED,
+                                          mmap.PROT_READ | mmap.PROT_WRITE,
+                                          offset=buf.m.offset))
+            self._ioctl(VIDIOC_QBUF, buf)
+    
+    def _start(self):
+        self._ioctl(VIDIOC_STREAMON, ctypes.c_int(V4L2_BUF_TYPE_VIDEO_CAPTURE))
+        self.streaming = True
+    
+    def _dequeue(self):
+        """Dequeue one filled buffer, or None if none is ready."""
+        buf = v4l2_buffer()
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE
+        buf.memory = V4L2_MEMORY_MMAP
+        try:
+            self._ioctl(VIDIOC_DQBUF, buf)
+        except OSError as e:
+            if e.errno == errno.EAGAIN:
+                return None
+            raise
+        return buf
+    
+    def _timestamp(self, buf):
+        """Driver capture time converted to Unix time."""
+        ts = buf.timestamp.tv_sec + buf.timestamp.tv_usec / 1e6
+        if buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC and ts > 0:
+            return time.time() - (time.monotonic() - ts)
+        return time.time()
+    
+    def read_frame(self, timeout=2.0):
+        """
+        Get the most recent frame, skipping any older ones already captured.
+        
+        Args:
+            timeout: Seconds to wait if no frame is ready
+        
+        Returns:
+            (data, timestamp, sequence) where data is JPEG bytes for MJPG or
+            a BGR numpy array for YUYV, or None on timeout
+        """
+        if not self.streaming:
+            return None
+        
+        latest = self._dequeue()
+        if latest is None:
+            ready, _, _ = select.select([self.fd], [], [], timeout)
+            if not ready:
+                return None
+            latest = self._dequeue()
+            if latest is None:
+                return None
+        
+        # Drain stale buffers, keeping only the newest
+        while True:
+            newer = self._dequeue()
+            if newer is None:
+                break
+            self._ioctl(VIDIOC_QBUF, latest)
+            self.dropped += 1
+            latest = newer
+        
+        try:
+            mm = self.buffers[latest.index]
+            if self.pixel_format == 'MJPG':
+                data = ensure_huffman_tables(mm[:latest.bytesused])
+            else:
+                yuyv = np.frombuffer(mm, dtype=np.uint8, count=self.bytesperline * self.height)
+                yuyv = yuyv.reshape(self.height, self.bytesperline // 2, 2)[:, :self.width]
+                data = cv2.cvtColor(yuyv, cv2.COLOR_YUV2BGR_YUYV)
+                del yuyv  # Release the export on the mmap before re-queueing
+            timestamp = self._timestamp(latest)
+        finally:
+            self._ioctl(VIDIOC_QBUF, latest)
+        
+        self.sequence += 1
+        self.last_timestamp = timestamp
+        return data, timestamp, self.sequence
+    
+    # cv2.VideoCapture-compatible subset used by Camera
+    
+    def isOpened(self):
+        return self.streaming
+    
+    def read(self):
+        """Read the latest frame as a BGR image: (ret, image)."""
+        result = self.read_frame()
+        if result is None:
+            return False, None
+        data = result[0]
+        if self.pixel_format == 'MJPG':
+            data = decode_jpeg(data)
+            if data is None:
+                return False, None
+        return True, data
+    
+    def release(self):
+        """Stop streaming and free the buffers."""
+        if self.fd is None:
+            return
+        if self.streaming:
+            try:
+                self._ioctl(VIDIOC_STREAMOFF, ctypes.c_int(V4L2_BUF_TYPE_VIDEO_CAPTURE))
+            except OSError as e:
+                logger.warning(f"STREAMOFF failed: {e}")
+            self.streaming = False
+        for mm in self.buffers:
+            mm.close()
+        self.buffers = []
+        os.close(self.fd)
+        self.fd = None
+    
+    def __del__(self):
+        self.release()
+
+
+def test_v4l2(device='/dev/video0', pixel_format='YUYV'):
+    """Capture from a device (e.g. the vivid virtual driver) and report timing."""
+    print(f"Testing V4L2 capture on {device} ({pixel_format})...")
+    
+    try:
+        cap = V4L2Capture(device, (1280, 720), pixel_format)
+    except Exception as e:
+        print(f"V4L2 test FAILED: {e}")
+        return
+    
+    print(f"  Device: {cap.card}, {cap.width}x{cap.height}")
+    
+    timestamps = []
+    latencies = []
+    for _ in range(30):
+        result = cap.read_frame()
+        if result is None:
+            print("  Timed out waiting for a frame")
+            break
+        timestamps.append(result[1])
+        latencies.append(time.time() - result[1])
+    
+    # Let frames pile up, then check that the read skips straight to the newest
+    time.sleep(1.0)
+    dropped_before = cap.dropped
+    result = cap.read_frame()
+    skipped = cap.dropped - dropped_before
+    cap.release()
+    
+    ok = len(timestamps) == 30 and all(b >= a for a, b in zip(timestamps, timestamps[1:]))
+    if ok:
+        fps = (len(timestamps) - 1) / (timestamps[-1] - timestamps[0])
+        print(f"  {fps:.1f} fps, driver-to-read latency median "
+              f"{sorted(latencies)[len(latencies) // 2] * 1000:.1f} ms")
+        print(f"  After a 1 s pause: skipped {skipped} stale frames, "
+              f"returned frame age {(time.time() - result[1]) * 1000:.0f} ms")
+    
+    print("V4L2 test PASSED" if ok else "V4L2 test FAILED")
+
+
+if __name__ == '__main__':
+    import sys
+    logging.basicConfig(level=logging.DEBUG)
+    test_v4l2(*sys.argv[1:3])